@@ -4,8 +4,14 @@
  * Functions:
  * init() - initilize receiving. Call in setup();
  * connected() - check if the controller is currently connected. 
+ * connectionState() - get the connection state (CONNECTING, LIVE, DEGRADED, or LOST).
+ * setTimeouts(degraded, lost) - set how long without data before the connection is degraded/lost.
+ * setFailsafe(zeroOutputs) - zero all the values when the connection is lost.
  * receiveData() - read any data that has been sent to the receiver. Call this often or you will loose stuff.
- * setJoyDeadzone(deadzone) - set a deadzone for the joysticks.
+ * setDrain(drain, maxBytes, maxTime) - read every waiting packet in each receiveData() call.
+ * setJoyDeadzone(deadzone, shape) - set a deadzone for the joysticks (AXIAL or RADIAL).
+ * setJoyCurve(side, curve, expo) - set the response curve for a joystick.
+ * setTriggerCurve(side, curve, expo) - set the response curve for a trigger.
  *
  * joystick(side, axis) - get the joystick value for the given side and axis
  * trigger(side) - get the trigger value on the given side
@@ -20,13 +26,37 @@
  * dpadClick(dir) - check if a dpad button has been clicked
  * bumperClick(side) - check if a bumpre has been clicked
  *
+ * addGesture(type, buttons, time) - watch for a double click, hold, or chord of buttons
+ * gesture(id) - check if a gesture has happened
+ * buttonHistory(index, state, time) - get a past button state
+ *
+ * dataAge(field, side) - time since a field was last received
+ * latency() - estimated one-way latency (needs stamping turned on in the sender)
+ * jitter() - estimated latency jitter (needs stamping turned on in the sender)
+ * packetsLost() - number of packets missing from the stamp sequence
+ * inSync() - check if the last keepalive digest matched our values
+ * field(field) - get the value of an extension field (see ControllerFields.h)
+ * fieldAge(field) - time since an extension field was last received
+ * (button edge counts from the controller's redundancy mode are used automatically)
+ * setRefreshRequests(enabled) - ask the controller for a full send when the digest doesn't match
+ *
  */
  
 #include "Controller.h"
 
 #define BAUDRATE 115200
-#define CONNECTION_TIMEOUT 1000
+#define DEGRADED_TIMEOUT 900   //a bit over the sender's 800ms keepalive interval
+#define LOST_TIMEOUT 1000
 #define PACKET_TIMEOUT 5  //max amount of time a transmission should ever take to send
+#define STAMP_PERIOD 4096 //the sender stamp time wraps at this many ms
+#define OFFSET_WINDOW 64  //number of stamps per window when tracking the clock offset
+#define REQUEST_INTERVAL 100  //min time between refresh requests
+#define LISTEN_INTERVAL 2000  //time between LISTENING bytes to the controller
+#define MAX_MISSED 2  //most buttons with missed edges in one set of edge counts
+
+//bytes sent back to the controller: ask for a full send, and "requests will get through"
+#define REFRESH_REQUEST 0xA5
+#define LISTENING 0x5A
 
 //Data header bitmasks
 #define LEFT_JOY_X    0b00000001
@@ -37,6 +67,9 @@
 #define RIGHT_TRIGGER 0b00001000
 #define LEFT_BUTTONS  0b00010000
 #define RIGHT_BUTTONS 0b00100000
+#define STAMP         0b01000000
+#define EXTENDED      0b10000000
+#define KEEPALIVE     0b01000000  //a stamp with no data is never sent
 
 //masks to use with the header to figure out what data is coming
 const uint8_t headerMasks[] = {
@@ -50,21 +83,80 @@ const uint8_t headerMasks[] = {
   RIGHT_BUTTONS
 };
 
+//data targets past the base data
+#define TARGET_DIGEST  10
+#define TARGET_BITMAP  11
+#define TARGET_CHECK   12
+#define TARGET_EXT     16  //plus the byte offset in extRaw
+
+//bitmap bits that are extension fields
+const uint8_t EXT_MASK = (1 << NUM_EXT_FIELDS) - 1;
+
+//header field (bit index) for each data target. Used for tracking the data age.
+const uint8_t targetFields[] = { 0, 0, 1, 1, 2, 3, 4, 5 };
+
+//scale for the values in the decode tables
+#define TABLE_ONE 32767
+const float TABLE_SCALE = 1.0 / TABLE_ONE;
+
+//scales for decoding without a table
+const float JOY_SCALE = 1.0 / 127.5;
+const float TRIGGER_SCALE = 1.0 / 255.0;
+
 //Define offsets for buttons (the rest are in enums).
 #define JOY_BUTTON   4
 #define BUMPER       5
 
+//Gesture stages
+#define GESTURE_IDLE     0
+#define GESTURE_STARTED  1  //first click, hold, or chord button down
+#define GESTURE_DONE     2  //hold has fired. Wait for release.
+
 /**
  * Constructor for the class.
 */
-Controller::Controller(HardwareSerial &xbeeSerial) : xbeeSerial(xbeeSerial) {
-  for (int i = 0; i < 8; i++) {
+Controller::Controller(HardwareSerial &xbeeSerial) 
+    : degradedTimeout(DEGRADED_TIMEOUT), lostTimeout(LOST_TIMEOUT), xbeeSerial(xbeeSerial) {
+  for (int i = 0; i < MAX_TARGETS; i++) {
     dataTargets[i] = 0;  
   }
+  for (int i = 0; i < 6; i++) {
+    fieldReceive[i] = 0;  
+  }
+  
+  //start with everything zeroed (in case this isn't a global)
+  for (int i = 0; i < 2; i++) {
+    joy[i][X] = 0.0;
+    joy[i][Y] = 0.0;
+    triggers[i] = 0.0;
+    buttons[i] = 0;
+    buttonClicks[i] = 0;
+    joyRaw[i][X] = 0;
+    joyRaw[i][Y] = 0;
+    triggerRaw[i] = 0;
+  }
+  
+  //extension fields, with the offset of each in extRaw
+  uint8_t offset = 0;
+  for (int i = 0; i < NUM_EXT_FIELDS; i++) {
+    extValues[i] = 0.0;
+    extReceive[i] = 0;
+    extOffset[i] = offset;
+    offset += extFields[i].width;
+  }
+  for (int i = 0; i < MAX_EXT_BYTES; i++) {
+    extRaw[i] = 0;
+  }
+}
 
-  //We haven't received anything yet, so make difference greater than the limit
-  lastReceive = -CONNECTION_TIMEOUT;
-
+/**
+ * Destructor for the class. Frees any decode tables.
+*/
+Controller::~Controller() {
+  for (int i = 0; i < 2; i++) {
+    delete joyTables[i];
+    delete triggerTables[i];
+  }
 }
 
 /**
@@ -84,10 +176,6 @@ void Controller::init() {
  * @return the joystick value on the axis. 
  */
 float Controller::joystick(Dir side, Axis axis) {
-    if (abs(joy[side][axis]) < joyDeadzone) {
-        return 0.0;
-    }
-    
     return joy[side][axis];
 }
 
@@ -155,25 +243,297 @@ bool Controller::getButtonState(Dir side, uint8_t button) {
 
 
 /**
- * @brief Check if we have received data recently
+ * @brief Check if we have received data recently. This doesn't read any data, so 
+ * receiveData() still needs to be called.
  * 
- * @return true if we have received data recently, false otherwise.
+ * @return true if the connection is LIVE or DEGRADED, false otherwise.
  */
 bool Controller::connected() {
-    //try to receive any available data
-    receiveData();
+    return receivedAny && (millis() - lastReceive) < lostTimeout;
+}
+
+/**
+ * @brief Get the state of the connection. This is based on the time since the last 
+ * complete transmission:
+ *   - CONNECTING: nothing received yet
+ *   - LIVE: received within the degraded timeout
+ *   - DEGRADED: late, but not past the lost timeout. Values may be stale.
+ *   - LOST: nothing received within the lost timeout
+ * 
+ * @return the connection state.
+ */
+ConnectionState Controller::connectionState() {
+    uint32_t silence = millis() - lastReceive;
+    
+    if (!receivedAny) {
+        return CONNECTING;
+    } else if (silence < degradedTimeout) {
+        return LIVE;
+    } else if (silence < lostTimeout) {
+        return DEGRADED;
+    }
+    
+    return LOST;
+}
+
+/**
+ * @brief Set the timeouts for the connection state. The sender sends something (a 
+ * keepalive if nothing else) at least every refresh interval (800ms by default), so 
+ * both timeouts have to be longer than that or a quiet but healthy link will read as 
+ * DEGRADED/LOST. A faster failsafe takes both ends: lower the refresh interval in the 
+ * sender with setRefreshInterval() and then lower these to match. For example, 
+ * setRefreshInterval(30) on the sender with setTimeouts(60, 100) here stops the robot 
+ * within 100ms of losing the link. The degraded timeout is clamped to below the lost one.
+ * 
+ * @param degradedTimeout - time in ms without data before the connection is DEGRADED.
+ * @param lostTimeout - time in ms without data before the connection is LOST (at least 1).
+ */
+void Controller::setTimeouts(uint16_t degradedTimeout, uint16_t lostTimeout) {
+    if (lostTimeout == 0) {
+        lostTimeout = 1;
+    }
+    if (degradedTimeout >= lostTimeout) {
+        degradedTimeout = lostTimeout - 1;
+    }
+    this->degradedTimeout = degradedTimeout;
+    this->lostTimeout = lostTimeout;
+}
 
-    //check if we have timed out
-    return (millis() - lastReceive) < CONNECTION_TIMEOUT;
+/**
+ * @brief Turn the failsafe on or off. When on, all of the joysticks, triggers, and 
+ * buttons are zeroed when the connection is LOST. This happens in receiveData().
+ * 
+ * @param zeroOutputs - true to zero the values on a lost connection. (Off by default).
+ */
+void Controller::setFailsafe(bool zeroOutputs) {
+    failsafe = zeroOutputs;
+}
+
+/**
+ * @brief Zero all of the values if the failsafe is on and the connection is lost. This 
+ * is done on every check so partial transmissions can't sneak values back in.
+ */
+void Controller::checkFailsafe() {
+    if (failsafeActive()) {
+        for (int i = 0; i < 2; i++) {
+            joy[i][X] = 0.0;
+            joy[i][Y] = 0.0;
+            triggers[i] = 0.0;
+            buttons[i] = 0;
+            buttonClicks[i] = 0;
+        }
+        
+        //the raw bytes still hold what was last received, so the digest would say the 
+        //zeroed values are current. Hold it out of sync until every field comes in again.
+        heldFields = 0b00111111;
+        stateInSync = false;
+        
+        //extension buttons too (sensor values are left alone). They are no longer what 
+        //the controller sent, so leave them out of the digest until they come in again.
+        for (int i = 0; i < NUM_EXT_FIELDS; i++) {
+            if (extFields[i].digital) {
+                extValues[i] = 0.0;
+                extSeen &= ~(1 << i);
+            }
+        }
+        
+        recordButtons(millis());
+    }
 }
 
 /**
-* Set a range of values under which joystick values will be ignored.
+ * @brief Check if the failsafe is holding the values at zero.
+ * 
+ * @return true if the failsafe is on and the connection is lost.
+ */
+bool Controller::failsafeActive() {
+    return failsafe && connectionState() == LOST;
+}
+
+/**
+ * @brief Get the time since a field was last received. This is the age of the value 
+ * returned by the getters for the field.
+ * 
+ * @param field - Field to check. (JOY_DATA, TRIGGER_DATA, or BUTTON_DATA).
+ * @param side - Side of the field. (LEFT or RIGHT).
+ * @return time in ms since the field was received (or since startup if never received).
+ */
+uint32_t Controller::dataAge(Field field, Dir side) {
+    return millis() - fieldReceive[field * 2 + side];
+}
+
+/**
+ * @brief Get the value of an extension field.
+ * 
+ * @param field - Extension field to get (see ControllerFields.h).
+ * @return the value in the field's units (0.0 if never received).
+ */
+float Controller::field(ExtField field) {
+    return extValues[field];
+}
+
+/**
+ * @brief Get the time since an extension field was last received.
+ * 
+ * @param field - Extension field to check.
+ * @return time in ms since the field was received (or since startup if never received).
+ */
+uint32_t Controller::fieldAge(ExtField field) {
+    return millis() - extReceive[field];
+}
+
+/**
+ * @brief Get the estimated one-way latency of the link. The clocks of the sender and 
+ * receiver are not synced, so the clock offset is estimated from the fastest recent 
+ * packet. This means the fixed part of the latency (the fastest a packet can get 
+ * through) gets folded into the offset. What is left is the queuing and retry delay.
+ * 
+ * Only available if stamping is turned on in the sender.
+ * 
+ * @return smoothed latency in ms.
+ */
+uint16_t Controller::latency() {
+    return (latencyAvg + 8) / 16;
+}
+
+/**
+ * @brief Get the estimated jitter of the link. This is the smoothed difference in 
+ * transit time between packets (the same estimate as RTP uses).
+ * 
+ * Only available if stamping is turned on in the sender.
+ * 
+ * @return smoothed jitter in ms.
+ */
+uint16_t Controller::jitter() {
+    return (jitterAvg + 8) / 16;
+}
+
+/**
+ * @brief Get the number of packets that were skipped in the stamp sequence. The 
+ * sequence is only 4 bits, so a run of more than 8 lost packets isn't counted (it 
+ * can't be told apart from a late packet). Duplicates aren't counted either.
+ * 
+ * Only available if stamping is turned on in the sender.
+ * 
+ * @return number of packets lost since startup.
+ */
+uint16_t Controller::packetsLost() {
+    return lostCount;
+}
+
+/**
+ * @brief Check if our values match the controller's. This is checked each time a 
+ * keepalive comes in (every 800ms when idle).
+ * 
+ * @return true if the last keepalive digest matched, false otherwise.
+ */
+bool Controller::inSync() {
+    return stateInSync;
+}
+
+/**
+ * @brief Turn refresh requests on or off. When on, a byte is sent back to the controller 
+ * to ask for a full send if a keepalive digest doesn't match, and a LISTENING byte is sent 
+ * back every LISTEN_INTERVAL so the controller knows requests can get through. When off 
+ * (or on a one-way link), the controller hears nothing back, so it does a full send every 
+ * refresh interval (800ms by default).
+ * 
+ * @param enabled - true to send requests. (Off by default, so the receiver only writes to 
+ * the port when asked to).
+ */
+void Controller::setRefreshRequests(bool enabled) {
+    refreshRequests = enabled;
+}
+
+/**
+* Set a range of values under which joystick values will be ignored. An AXIAL deadzone 
+* zeroes each axis on its own when it is inside the deadzone. A RADIAL deadzone zeroes 
+* both axes when the stick is inside a circle, so diagonals aren't cut off. The deadzone 
+* is checked on the stick position before the response curve.
 *
 * @param deadzone - value in the range 0.0 to 1.0.
+* @param shape - AXIAL or RADIAL. (Default is AXIAL).
 */
-void Controller::setJoyDeadzone(float deadzone) {
+void Controller::setJoyDeadzone(float deadzone, DeadzoneShape shape) {
   joyDeadzone = deadzone;
+  deadzoneShape = shape;
+  
+  //radial deadzone is checked on the raw bytes as (2 * raw - 255), which is -255 to 255
+  float radius = deadzone * 255;
+  radialDeadzone = radius * radius;
+  
+  buildJoyTable(LEFT);
+  buildJoyTable(RIGHT);
+}
+
+/**
+* Set the response curve for a joystick. LINEAR passes the value through. EXPO softens 
+* the middle of the stick for finer control: out = (1 - expo) * in + expo * in^3.
+*
+* @param side - Side of the joystick. (LEFT or RIGHT).
+* @param curve - LINEAR or EXPO.
+* @param expo - amount of expo in the range 0.0 to 1.0. (Only used for EXPO).
+*/
+void Controller::setJoyCurve(Dir side, Curve curve, float expo) {
+  setCurve(joyTables[side], curve, expo, NULL, 0);
+  buildJoyTable(side);
+}
+
+/**
+* Set a custom response curve for a joystick. The points are the output for evenly spaced 
+* stick positions from center (first point) to full (last point). Values between the 
+* points are interpolated. The curve is mirrored for the negative side.
+*
+* @param side - Side of the joystick. (LEFT or RIGHT).
+* @param points - output values in the range 0.0 to 1.0.
+* @param numPoints - number of points. (2 to MAX_CURVE_POINTS).
+*/
+void Controller::setJoyCurve(Dir side, const float points[], uint8_t numPoints) {
+  setCurve(joyTables[side], CUSTOM, 0.0, points, numPoints);
+  buildJoyTable(side);
+}
+
+/**
+* Set the response curve for a trigger. Same as setJoyCurve().
+*
+* @param side - Side of the trigger. (LEFT or RIGHT).
+* @param curve - LINEAR or EXPO.
+* @param expo - amount of expo in the range 0.0 to 1.0. (Only used for EXPO).
+*/
+void Controller::setTriggerCurve(Dir side, Curve curve, float expo) {
+  setCurve(triggerTables[side], curve, expo, NULL, 0);
+  buildTriggerTable(side);
+}
+
+/**
+* Set a custom response curve for a trigger. Same as setJoyCurve(), from released 
+* (first point) to fully pressed (last point).
+*
+* @param side - Side of the trigger. (LEFT or RIGHT).
+* @param points - output values in the range 0.0 to 1.0.
+* @param numPoints - number of points. (2 to MAX_CURVE_POINTS).
+*/
+void Controller::setTriggerCurve(Dir side, const float points[], uint8_t numPoints) {
+  setCurve(triggerTables[side], CUSTOM, 0.0, points, numPoints);
+  buildTriggerTable(side);
+}
+
+//CRC-8 (polynomial 0x07) of each 4-bit value, for crc8()
+const uint8_t CRC_NIBBLES[16] = { 0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 
+                                   0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D };
+
+/**
+ * Add a byte to a CRC-8 (polynomial 0x07, the same as the controller), a nibble at a time.
+ * 
+ * @param crc - the CRC so far.
+ * @param val - the byte to add.
+ * @return the new CRC.
+ */
+uint8_t crc8(uint8_t crc, uint8_t val) {
+  crc ^= val;
+  crc = (crc << 4) ^ CRC_NIBBLES[crc >> 4];
+  crc = (crc << 4) ^ CRC_NIBBLES[crc >> 4];
+  return crc;
 }
 
 //Don't mind us. We are for debugging.
@@ -193,23 +553,76 @@ void printBinary(int val) {
 * The serialEvent() function can be used for this, but it may not be fast enough if loop() takes 
 * a long time. 
 * 
+* Normally this reads one packet per call. In drain mode it keeps reading packets as long as a 
+* complete one is waiting, up to the byte and time limits. Every button change is still seen 
+* (clicks and gestures), but the joysticks are only decoded once with the newest values.
+* 
+* After reading:
+*  - Decode the newest joystick values.
+*  - If the connection has been lost, apply the failsafe.
+*  - Check the held buttons for gestures.
+*/
+void Controller::receiveData() {
+    uint32_t callStart = millis();
+    uint16_t bytesRead = 0;
+    
+    //read one packet, or everything waiting when draining
+    do {
+        bytesRead += receivePacket();
+    } while (drain && bytesRead < drainBytes && millis() - callStart < drainTime && packetWaiting());
+    
+    //decode the newest joystick values
+    if (joyUpdated & (1 << LEFT)) {
+        applyJoy(LEFT);
+    }
+    if (joyUpdated & (1 << RIGHT)) {
+        applyJoy(RIGHT);
+    }
+    joyUpdated = 0;
+    
+    checkFailsafe();
+    checkHolds(millis());
+}
+
+/**
+* Read a packet from the serial buffer.
+* 
 * How this works:
 *  - Get the first valid data header from the serial buffer. 
 *  - Use the data header to construct an array of targets for the upcoming data.
 *  - Loop until we have received all data (curByte == numBytes), or we have timed out.
-*  - Each time we get a new byte of data, save based on the target for that byte.
-*  - Every time we receive any data, update the last receive time.
+*  - Each time we get a new byte of data, keep it (and add it to the packet CRC).
+*  - An extended packet or a keepalive is only used if it all came in and its CRC 
+*    matches. A packet without extension fields is used as far as it came in, like before.
+*  - Save each byte based on its target.
+*  - If the buttons changed, add them to the history and update the gestures.
+*  - If we received a complete transmission, update the last receive time.
+* 
+* @return number of bytes read from the serial buffer.
 */
-void Controller::receiveData() {
+uint8_t Controller::receivePacket() {
     uint8_t dataHeader = 0;  //header for the packet of send data
     int8_t curByte = 0;      //current byte in the transmission
     int8_t numBytes = 0;     //number of bytes in the transmission
+    uint8_t packet[MAX_TARGETS];  //bytes of the packet (used once it checks out)
+    uint8_t check = 0;       //CRC of the packet so far (extended packets and keepalives)
+    bool checkOk = false;    //the packet CRC (if sent) matched
+    uint16_t stamp = 0;      //sender stamp (if sent)
+    uint8_t extBitmap = 0;   //extension fields (if sent)
+    uint8_t newButtons[2] = {0, 0};  //button bytes (applied after the packet)
+    uint8_t buttonsIn = 0;   //bit for each side with a button byte
+    uint16_t edges[2];       //button edge counts (if sent)
+    bool edgesOk = true;     //edge counts (if sent) pass their check
+    uint8_t edgesOff = 0;    //bit for each side whose counts are marked as stopped
+    uint8_t bytesRead = 0;   //bytes taken from the serial buffer
     
     if (xbeeSerial.available()) {
         //read the first valid header
         dataHeader = xbeeSerial.read();
+        bytesRead++;
         while (xbeeSerial.available() && !isValidHeader(dataHeader)) {
             dataHeader = xbeeSerial.read();
+            bytesRead++;
         }
 
         //if we found a valid header, read the following data
@@ -220,59 +633,360 @@ void Controller::receiveData() {
     
             //Get ready to receive the data
             unsigned long int readStart = millis();
+            bool checked = (dataHeader & EXTENDED) || dataHeader == KEEPALIVE;
+            if (checked) {
+                check = crc8(check, dataHeader);
+            }
             
             //read until done or timeout
-            while (millis() - readStart < PACKET_TIMEOUT && curByte < numBytes) {
+            while (millis() - readStart < PACKET_TIMEOUT && curByte < numBytes && numBytes > 0) {
                 if (xbeeSerial.available()) {
-                    //read the data into the target for the current byte
-                    switch(dataTargets[curByte]) {
-                      case 0:
-                        updateJoy(LEFT, X, xbeeSerial.read());
-                        break;
-                      case 1:
-                        updateJoy(LEFT, Y, xbeeSerial.read());
-                        break;
-                      case 2:
-                        updateJoy(RIGHT, X, xbeeSerial.read());
-                        break;
-                      case 3:
-                        updateJoy(RIGHT, Y, xbeeSerial.read());
-                        break;
-                      case 4:
-                        updateTrigger(LEFT, xbeeSerial.read());
-                        break;
-                      case 5:
-                        updateTrigger(RIGHT, xbeeSerial.read());
-                        break;
-                      case 6:
-                        updateButtons(LEFT, xbeeSerial.read());
-                        break;
-                      case 7:
-                        updateButtons(RIGHT, xbeeSerial.read());
-                        break;
+                    uint8_t val = xbeeSerial.read();
+                    packet[curByte] = val;
+                    
+                    if (checked) {
+                        if (dataTargets[curByte] == TARGET_CHECK) {
+                            checkOk = val == check;
+                        } else {
+                            check = crc8(check, val);
+                        }
                     }
-    
+                    
+                    if (dataTargets[curByte] == TARGET_BITMAP) {
+                        extBitmap = val;
+                        //the fields come after everything else
+                        if (extBitmap && !(extBitmap & ~EXT_MASK)) {
+                          numBytes += getExtTargets(dataTargets + numBytes, extBitmap);
+                        } else {
+                          //not a bitmap we know. Throw out the packet.
+                          numBytes = -1;
+                        }
+                    }
+                    
                     //go to the next byte
                     curByte++;
                 }
             }
+            bytesRead += curByte;
+            
+            //an extended packet carries edge counts and may have slid over a lost byte, so 
+            //it has to be whole and match its CRC. Otherwise none of it is used. The same 
+            //goes for a keepalive, or a stray byte could keep a dead link alive.
+            if (checked && !(curByte == numBytes && checkOk)) {
+                return bytesRead;
+            }
+            
+            //save the data into the targets
+            for (int i = 0; i < curByte; i++) {
+                switch(dataTargets[i]) {
+                  case 0:
+                    updateJoy(LEFT, X, packet[i]);
+                    break;
+                  case 1:
+                    updateJoy(LEFT, Y, packet[i]);
+                    break;
+                  case 2:
+                    updateJoy(RIGHT, X, packet[i]);
+                    break;
+                  case 3:
+                    updateJoy(RIGHT, Y, packet[i]);
+                    break;
+                  case 4:
+                    updateTrigger(LEFT, packet[i]);
+                    break;
+                  case 5:
+                    updateTrigger(RIGHT, packet[i]);
+                    break;
+                  case 6:
+                    newButtons[LEFT] = packet[i];
+                    buttonsIn |= 1 << LEFT;
+                    break;
+                  case 7:
+                    newButtons[RIGHT] = packet[i];
+                    buttonsIn |= 1 << RIGHT;
+                    break;
+                  case 8:
+                    stamp = packet[i] << 8;
+                    break;
+                  case 9:
+                    stamp |= packet[i];
+                    break;
+                  case TARGET_DIGEST:
+                    checkDigest(packet[i], readStart);
+                    break;
+                  case TARGET_BITMAP:
+                  case TARGET_CHECK:
+                    break;
+                  default:
+                    extRaw[dataTargets[i] - TARGET_EXT] = packet[i];
+                    break;
+                }
+            }
+            
+            //check the edge counts (the CRC should have caught anything bad already)
+            for (int side = LEFT; side <= RIGHT; side++) {
+                if (extBitmap & (1 << (BUTTON_EDGES_L + side))) {
+                    const uint8_t *bytes = &extRaw[extOffset[BUTTON_EDGES_L + side]];
+                    edges[side] = ((uint16_t)bytes[0] << 8) | bytes[1];
+                    if (edgeCheck(edges[side], EDGE_OFF)) {
+                        edgesOff |= 1 << side;
+                    } else {
+                        edgesOk = edgesOk && edgeCheck(edges[side], EDGE_CHECK);
+                    }
+                }
+            }
+            
+            //update the buttons and run the gestures if they changed. While the controller 
+            //is sending edge counts, it sends them with every button byte, so a button byte 
+            //without them came from a shifted packet. Once it marks them as stopped, plain 
+            //button bytes are taken again.
+            if (edgesOk) {
+                for (int side = LEFT; side <= RIGHT; side++) {
+                    bool checked = extBitmap & (1 << (BUTTON_EDGES_L + side));
+                    if ((buttonsIn & (1 << side)) && (checked || !edgesSynced[side])) {
+                        updateButtons((Dir)side, newButtons[side]);
+                    }
+                    if (edgesOff & (1 << side)) {
+                        edgesSynced[side] = false;
+                    }
+                }
+            }
+            recordButtons(readStart);
+            
+            if (curByte == numBytes) {
+                //edge counts can't be trusted after losing the connection
+                if (connectionState() == LOST) {
+                    edgesSynced[LEFT] = false;
+                    edgesSynced[RIGHT] = false;
+                }
+                
+                //let the controller know that refresh requests can reach it
+                if (refreshRequests && (!receivedAny || readStart - lastListen >= LISTEN_INTERVAL)) {
+                    xbeeSerial.write((uint8_t)LISTENING);
+                    lastListen = readStart;
+                }
+                
+                //update the time of last receiving data
+                lastReceive = readStart;
+                receivedAny = true;
+                
+                //track when each field was received
+                for (int i = 0; i < numBytes; i++) {
+                    if (dataTargets[i] < 8) {
+                        fieldReceive[targetFields[dataTargets[i]]] = readStart;
+                        heldFields &= ~(1 << targetFields[dataTargets[i]]);
+                    }
+                }
+                
+                //fields still zeroed by the failsafe won't come in until they change, so 
+                //ask for them rather than wait for the next full send
+                if (heldFields) {
+                    requestRefresh(readStart);
+                }
+                
+                //use the stamp to track latency
+                if ((dataHeader & STAMP) && dataHeader != KEEPALIVE) {
+                    updateStamp(stamp, readStart);
+                }
+                
+                //decode the extension fields
+                if (extBitmap) {
+                    applyExt(extBitmap, readStart);
+                    
+                    //catch up on any button edges we missed
+                    for (int side = LEFT; side <= RIGHT; side++) {
+                        if (edgesOk && (extBitmap & (1 << (BUTTON_EDGES_L + side))) && !(edgesOff & (1 << side))) {
+                            checkEdges((Dir)side, edges[side] & 0x0FFF, buttonsIn & (1 << side), readStart);
+                        }
+                    }
+                }
+            }
         }
+    }
+    
+    return bytesRead;
+}
 
-        
-        //update the time of last receiving data
-        lastReceive = millis();
+/**
+ * Check if a whole packet is waiting in the serial buffer. Bytes that can't be a header 
+ * are thrown out along the way. Used by drain mode so it doesn't wait on a partial packet. 
+ * For an extended packet, only the bytes up to the first field can be checked, so the 
+ * read of the rest may wait for up to PACKET_TIMEOUT.
+ * 
+ * @return true if a complete packet is waiting, false otherwise.
+ */
+bool Controller::packetWaiting() {
+    //skip anything that isn't a header
+    while (xbeeSerial.available() && !isValidHeader(xbeeSerial.peek())) {
+        xbeeSerial.read();
     }
+    
+    if (!xbeeSerial.available()) {
+        return false;
+    }
+    
+    //header plus the data. The length of the extension fields is in the bitmap, which 
+    //can't be seen without reading past the header. Wait for the rest of the packet, the 
+    //first field byte, and the CRC. receivePacket() waits (up to PACKET_TIMEOUT) for any more.
+    uint8_t header = xbeeSerial.peek();
+    uint8_t targets[MAX_TARGETS];
+    int numBytes = getDataTargets(targets, header);
+    if (header & EXTENDED) {
+        numBytes += 2;
+    }
+    return xbeeSerial.available() > numBytes;
+}
+
+/**
+ * Turn drain mode on or off. In drain mode, each call to receiveData() reads every 
+ * complete packet waiting instead of just one. This catches up right away after a slow 
+ * loop instead of working through the backlog one packet per call.
+ * 
+ * @param drain - true to drain. (Off by default).
+ * @param maxBytes - stop draining after this many bytes in one call.
+ * @param maxTime - stop draining after this many ms in one call.
+ */
+void Controller::setDrain(bool drain, uint16_t maxBytes, uint8_t maxTime) {
+    this->drain = drain;
+    drainBytes = maxBytes;
+    drainTime = maxTime;
 }
 
 /**
  * Check if the given header is valid.
- * This checks to make sure header is not all zeros and last two bits are empty.
+ * This checks to make sure header is a keepalive or has some data (base or extension).
  * 
  * @param header - value to check.
  * @return true if valid, false otherwise.
  */
 bool Controller::isValidHeader(uint8_t header) {
-  return header != 0 && !(header & 0b11000000u);
+  return header == KEEPALIVE || (header & 0b10111111u) != 0;
+}
+
+/**
+ * Compare a keepalive digest to a digest of our values (the same CRC-8 the controller 
+ * uses, over the 8 data bytes as we received them and then the digital extension fields 
+ * we have received, except the edge counts). If they match, all of our values are still 
+ * current. If not, ask the controller for a full send.
+ * 
+ * @param digest - the digest from the keepalive.
+ * @param receiveTime - time the keepalive was received.
+ */
+void Controller::checkDigest(uint8_t digest, uint32_t receiveTime) {
+  uint8_t state[8] = {
+    joyRaw[LEFT][X], joyRaw[LEFT][Y], joyRaw[RIGHT][X], joyRaw[RIGHT][Y],
+    triggerRaw[LEFT], triggerRaw[RIGHT], buttons[LEFT], buttons[RIGHT]
+  };
+  uint8_t crc = 0;
+  
+  for (int i = 0; i < 8; i++) {
+    crc = crc8(crc, state[i]);
+  }
+  
+  uint8_t fields = extSeen & ~EDGE_FIELDS;
+  for (int i = 0; i < NUM_EXT_FIELDS; i++) {
+    if (extFields[i].digital && (fields & (1 << i))) {
+      for (int j = 0; j < extFields[i].width; j++) {
+        crc = crc8(crc, extRaw[extOffset[i] + j]);
+      }
+    }
+  }
+  
+  stateInSync = !heldFields && crc == digest;
+  
+  if (stateInSync) {
+    //everything is confirmed current
+    for (int i = 0; i < 6; i++) {
+      fieldReceive[i] = receiveTime;
+    }
+    for (int i = 0; i < NUM_EXT_FIELDS; i++) {
+      if (extFields[i].digital && (fields & (1 << i))) {
+        extReceive[i] = receiveTime;
+      }
+    }
+  } else {
+    requestRefresh(receiveTime);
+  }
+}
+
+/**
+ * Ask the controller for a full send, if refresh requests are on and one hasn't been 
+ * sent in the last REQUEST_INTERVAL.
+ * 
+ * @param time - current time.
+ */
+void Controller::requestRefresh(uint32_t time) {
+  if (refreshRequests && time - lastRequest >= REQUEST_INTERVAL) {
+    xbeeSerial.write((uint8_t)REFRESH_REQUEST);
+    lastRequest = time;
+  }
+}
+
+/**
+ * Update the latency, jitter, and lost packet tracking with a new stamp.
+ * 
+ * The transit time of each packet is (receive time - send time). Since the clocks 
+ * aren't synced, this includes an unknown offset. The fastest transit over the last 
+ * two windows of stamps is taken as the offset, and latency is measured relative to 
+ * that. All of the math is done on 12-bit wrapping times relative to stampBase.
+ * 
+ * @param stamp - the stamp from the packet. (seq[3:0], time[11:0]).
+ * @param receiveTime - time the packet header was received.
+ */
+void Controller::updateStamp(uint16_t stamp, uint32_t receiveTime) {
+  uint8_t sequence = stamp >> 12;
+
+  //restart if this is the first stamp or it has been long enough for the time to wrap
+  if (!stampSynced || receiveTime - lastStampReceive > STAMP_PERIOD / 2) {
+    stampBase = (receiveTime - stamp) & 0x0FFF;
+    lastOffsetMin = 0;
+    offsetMin = 0;
+    lastTransit = 0;
+    windowCount = 0;
+    latencyAvg = 0;
+    jitterAvg = 0;
+    stampSynced = true;
+  } else {
+    //count any skipped sequence numbers. A repeat of the last number is a duplicate, and 
+    //a big jump is more likely an old packet arriving late, so neither is counted. Two 
+    //big jumps in a row are a real gap (more than 8 lost), so follow it.
+    uint8_t delta = (sequence - lastSequence) & 0x0F;
+    if (delta > 8 && !sequenceJump) {
+      sequenceJump = true;
+      sequence = lastSequence;
+    } else {
+      if (delta > 0 && delta <= 8) {
+        lostCount += delta - 1;
+      }
+      sequenceJump = false;
+    }
+  }
+  lastSequence = sequence;
+  lastStampReceive = receiveTime;
+
+  //transit time relative to the base, wrapped to the range -2048 to 2047
+  int16_t transit = ((receiveTime - stamp - stampBase + STAMP_PERIOD / 2) & 0x0FFF) - STAMP_PERIOD / 2;
+
+  //the fastest packet gives the best estimate of the clock offset
+  if (transit < offsetMin) {
+    offsetMin = transit;
+  }
+  int16_t offset = min(offsetMin, lastOffsetMin);
+
+  //smooth the latency (gain of 1/8) and the jitter (gain of 1/16, same as RTP)
+  int16_t delta = abs(transit - lastTransit);
+  latencyAvg += ((int32_t)(transit - offset) * 16 - latencyAvg) / 8;
+  jitterAvg += ((int32_t)delta * 16 - jitterAvg) / 16;
+  lastTransit = transit;
+
+  //start a new window. Rebase on the fastest transit so clock drift gets followed.
+  if (++windowCount >= OFFSET_WINDOW) {
+    stampBase = (stampBase + offsetMin) & 0x0FFF;
+    lastTransit -= offsetMin;
+    lastOffsetMin = 0;
+    offsetMin = lastTransit;
+    windowCount = 0;
+  }
 }
 
 /**
@@ -282,8 +996,27 @@ bool Controller::isValidHeader(uint8_t header) {
  * @param dataHeader - the header of the data.
  * @return number of data targets found.
  */
-int8_t Controller::getDataTargets(uint8_t dataTargets[], int8_t dataHeader) {
+int8_t Controller::getDataTargets(uint8_t dataTargets[], uint8_t dataHeader) {
   int8_t numBytes = 0;
+  
+  //keepalive is just the digest and its CRC
+  if (dataHeader == KEEPALIVE) {
+    dataTargets[numBytes++] = TARGET_DIGEST;
+    dataTargets[numBytes++] = TARGET_CHECK;
+    return numBytes;
+  }
+  
+  //the extension bitmap comes first. The fields are added once it is read.
+  if (dataHeader & EXTENDED) {
+    dataTargets[numBytes++] = TARGET_BITMAP;
+  }
+  
+  //then the stamp
+  if (dataHeader & STAMP) {
+    dataTargets[numBytes++] = 8;
+    dataTargets[numBytes++] = 9;
+  }
+  
   for (int i = 0; i < 8; i++) {
     //add the target to our list if we have a match
     if (dataHeader & headerMasks[i]) {
@@ -295,6 +1028,67 @@ int8_t Controller::getDataTargets(uint8_t dataTargets[], int8_t dataHeader) {
   return numBytes;
 }
 
+/**
+ * Build the list of data targets for the extension fields. Each byte of a field goes 
+ * to its spot in extRaw, and the packet CRC comes last.
+ * 
+ * @param dataTargets - array to fill with data targets.
+ * @param extBitmap - the extension bitmap.
+ * @return number of data targets found.
+ */
+int8_t Controller::getExtTargets(uint8_t dataTargets[], uint8_t extBitmap) {
+  int8_t numBytes = 0;
+  
+  for (int i = 0; i < NUM_EXT_FIELDS; i++) {
+    if (extBitmap & (1 << i)) {
+      for (int j = 0; j < extFields[i].width; j++) {
+        dataTargets[numBytes++] = TARGET_EXT + extOffset[i] + j;
+      }
+    }
+  }
+  
+  //and the packet CRC
+  dataTargets[numBytes++] = TARGET_CHECK;
+  
+  return numBytes;
+}
+
+/**
+ * Decode the extension fields received in a packet.
+ * 
+ * @param extBitmap - the extension bitmap of the packet.
+ * @param receiveTime - time the packet was received.
+ */
+void Controller::applyExt(uint8_t extBitmap, uint32_t receiveTime) {
+  for (int i = 0; i < NUM_EXT_FIELDS; i++) {
+    if (extBitmap & (1 << i)) {
+      const FieldInfo &info = extFields[i];
+      const uint8_t *bytes = &extRaw[extOffset[i]];
+      int32_t count = 0;
+      
+      //high byte first
+      switch (info.encoding) {
+        case FIELD_U8:
+          count = bytes[0];
+          break;
+        case FIELD_S8:
+          count = (int8_t)bytes[0];
+          break;
+        case FIELD_U16:
+          count = ((uint16_t)bytes[0] << 8) | bytes[1];
+          break;
+        case FIELD_S16:
+          count = (int16_t)(((uint16_t)bytes[0] << 8) | bytes[1]);
+          break;
+      }
+      
+      extValues[i] = count * info.scale;
+      extReceive[i] = receiveTime;
+      extSeen |= 1 << i;
+    }
+  }
+}
+
 /**
 * Update the button values. Set the button's click bit if we hit a rising edge.
 *
@@ -302,31 +1096,285 @@ int8_t Controller::getDataTargets(uint8_t dataTargets[], int8_t dataHeader) {
 * @param newVal - New set of values for the buttons.
 */
 void Controller::updateButtons(Dir side, uint8_t newVal) {
-    buttonClicks[side] = newVal & ~buttons[side];  //set click to 1 if button went from 0 to 1
+    uint8_t changed = newVal ^ buttons[side];
+    buttonClicks[side] |= newVal & ~buttons[side];  //set click to 1 if button went from 0 to 1 (kept until read)
     buttons[side] = newVal;
+    
+    //count the edges (2 bits per button, like the controller)
+    for (int i = 0; changed; i++, changed >>= 1) {
+        if (changed & 1) {
+            uint16_t count = ((edgeCounts[side] >> (i * 2)) + 1) & 0b11;
+            edgeCounts[side] = (edgeCounts[side] & ~(0b11 << (i * 2))) | (count << (i * 2));
+        }
+    }
 }
 
 /**
- * @brief Update the value of the joystick. Take in an unsigned 8-bit char and convert 
- * to a float in the range -1.0 to 1.0.
+* Compare the controller's button edge counts to ours, and replay any edges we missed 
+* (through updateButtons() and recordButtons(), so the clicks and gestures see them). 
+* Counts we have already seen are ignored, so the repeats from the controller are harmless.
+* 
+* If the button byte came in the same packet, it is already the controller's state, so an 
+* odd number of missing edges means our counts are off. In that case (and for the first 
+* counts after connecting) we just take the controller's counts. If more than MAX_MISSED 
+* buttons are off, we are more likely out of step with the controller (like after a long 
+* dropout) than missing that many taps, so the counts are taken without replaying anything.
+*
+* @param side - Side of the buttons. (LEFT or RIGHT).
+* @param counts - 2-bit edge count for each button.
+* @param haveButtons - the packet had the button byte for this side.
+* @param time - time the packet was received.
+*/
+void Controller::checkEdges(Dir side, uint16_t counts, bool haveButtons, uint32_t time) {
+    uint8_t missed[6];
+    uint8_t numMissed = 0;
+    
+    for (int i = 0; i < 6; i++) {
+        missed[i] = ((counts >> (i * 2)) - (edgeCounts[side] >> (i * 2))) & 0b11;
+        
+        if (haveButtons && (missed[i] & 1)) {
+            missed[i] = 0;
+        }
+        
+        //3 missed edges in a row is much less likely than us being one ahead (from a 
+        //bad byte), so just flip back
+        if (missed[i] == 3) {
+            missed[i] = 1;
+        }
+        
+        if (missed[i]) {
+            numMissed++;
+        }
+    }
+    
+    //each edge flips the button
+    if (edgesSynced[side] && numMissed <= MAX_MISSED) {
+        for (int i = 0; i < 6; i++) {
+            for (; missed[i] > 0; missed[i]--) {
+                updateButtons(side, buttons[side] ^ (1 << i));
+                recordButtons(time);
+            }
+        }
+    }
+    
+    edgeCounts[side] = counts;
+    edgesSynced[side] = true;
+}
+
+
+/**
+* Check that a set of button edge counts is real (not bytes from a shifted packet). The 
+* top 4 bits are the three low nibbles xor'd together with EDGE_CHECK, or with EDGE_OFF 
+* if the controller has stopped sending counts.
+*
+* @param counts - the edge counts, with the check.
+* @param mark - EDGE_CHECK or EDGE_OFF.
+* @return true if the check matches.
+*/
+bool Controller::edgeCheck(uint16_t counts, uint8_t mark) {
+    uint8_t check = (counts ^ (counts >> 4) ^ (counts >> 8) ^ mark) & 0x0F;
+    return check == counts >> 12;
+}
+
+/**
+ * @brief Update the value of the joystick. The byte is saved and decoded once the 
+ * whole packet is in (see applyJoy()).
  * 
  * @param side - Side of the joystick. (LEFT or RIGHT).
  * @param axis - Axis to update. (X or Y).
  * @param newVal - New value for the joystick axis. Value in the range 0 to 255.
  */
 void Controller::updateJoy(Dir side, Axis axis, uint8_t newVal) {
-    joy[side][axis] = (newVal / 127.5) - 1.0;
+    joyRaw[side][axis] = newVal;
+    joyUpdated |= 1 << side;
 }
 
 /**
- * @brief Update the value of the trigger. Take in an unsigned 8-bit char and convert 
- * to a float in the range 0.0 to 1.0.
+ * @brief Decode the joystick bytes into values in the range -1.0 to 1.0, plus the 
+ * radial deadzone check if it is on.
+ * 
+ * @param side - Side of the joystick. (LEFT or RIGHT).
+ */
+void Controller::applyJoy(Dir side) {
+    float x = decodeJoy(side, joyRaw[side][X]);
+    float y = decodeJoy(side, joyRaw[side][Y]);
+    
+    if (deadzoneShape == RADIAL) {
+        int32_t rawX = 2 * joyRaw[side][X] - 255;
+        int32_t rawY = 2 * joyRaw[side][Y] - 255;
+        
+        if ((uint32_t)(rawX * rawX + rawY * rawY) < radialDeadzone) {
+            x = 0.0;
+            y = 0.0;
+        }
+    }
+    
+    joy[side][X] = x;
+    joy[side][Y] = y;
+}
+
+/**
+ * @brief Decode one joystick byte. This is a table lookup if the stick has a curve. 
+ * Otherwise it is just scaled (with the AXIAL deadzone).
+ * 
+ * @param side - Side of the joystick. (LEFT or RIGHT).
+ * @param raw - the received byte.
+ * @return the value in the range -1.0 to 1.0.
+ */
+float Controller::decodeJoy(Dir side, uint8_t raw) {
+    if (joyTables[side]) {
+        return joyTables[side]->values[raw] * TABLE_SCALE;
+    }
+    
+    float val = raw * JOY_SCALE - 1.0f;
+    if (deadzoneShape == AXIAL && fabs(val) < joyDeadzone) {  //fabs so there is no branch on the sign
+        return 0.0;
+    }
+    return val;
+}
+
+/**
+ * @brief Update the value of the trigger. The unsigned 8-bit char becomes a value in 
+ * the range 0.0 to 1.0.
  * 
  * @param side - Side of the trigger. (LEFT or RIGHT).
- * @param newVal - New value for the joystick axis. Value in the range 0 to 255.
+ * @param newVal - New value for the trigger. Value in the range 0 to 255.
  */
 void Controller::updateTrigger(Dir side, uint8_t newVal) {
-  triggers[side] = newVal / 255.0;
+  triggerRaw[side] = newVal;
+  triggers[side] = decodeTrigger(side, newVal);
+}
+
+/**
+ * @brief Decode one trigger byte. This is a table lookup if the trigger has a curve. 
+ * Otherwise it is just scaled.
+ * 
+ * @param side - Side of the trigger. (LEFT or RIGHT).
+ * @param raw - the received byte.
+ * @return the value in the range 0.0 to 1.0.
+ */
+float Controller::decodeTrigger(Dir side, uint8_t raw) {
+  if (triggerTables[side]) {
+    return triggerTables[side]->values[raw] * TABLE_SCALE;
+  }
+  return raw * TRIGGER_SCALE;
+}
+
+/**
+ * @brief Save the settings for a response curve. A table is only kept for curves other 
+ * than LINEAR, so LINEAR frees it (and the settings go with it).
+ * 
+ * @param table - the table for the stick or trigger. Set to the new table or NULL.
+ * @param curve - LINEAR, EXPO, or CUSTOM.
+ * @param expo - amount of expo for EXPO.
+ * @param points - points for CUSTOM.
+ * @param numPoints - number of points for CUSTOM.
+ */
+void Controller::setCurve(CurveTable *&table, Curve curve, float expo, const float points[], uint8_t numPoints) {
+  //a custom curve needs points
+  if (curve == CUSTOM && (numPoints < 2 || points == NULL)) {
+    curve = LINEAR;
+  }
+  
+  if (curve == LINEAR) {
+    delete table;
+    table = NULL;
+    return;
+  }
+  
+  if (table == NULL) {
+    table = new CurveTable;
+  }
+  
+  table->curve = curve;
+  table->expo = constrain(expo, 0.0, 1.0);
+  table->numPoints = 0;
+  
+  if (curve == CUSTOM) {
+    table->numPoints = min(numPoints, MAX_CURVE_POINTS);
+    for (uint8_t i = 0; i < table->numPoints; i++) {
+      table->points[i] = points[i];
+    }
+  }
+}
+
+/**
+ * @brief Run a value through a response curve.
+ * 
+ * @param table - the curve settings.
+ * @param val - value in the range 0.0 to 1.0.
+ * @return the curved value in the range 0.0 to 1.0.
+ */
+float Controller::applyCurve(const CurveTable &table, float val) {
+  float result = val;
+  
+  switch (table.curve) {
+    case EXPO:
+      result = (1.0 - table.expo) * val + table.expo * val * val * val;
+      break;
+    case CUSTOM: {
+      //find the points on either side and interpolate
+      float pos = val * (table.numPoints - 1);
+      uint8_t index = pos;
+      if (index >= table.numPoints - 1) {
+        result = table.points[table.numPoints - 1];
+      } else {
+        float frac = pos - index;
+        result = table.points[index] + (table.points[index + 1] - table.points[index]) * frac;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  
+  return constrain(result, 0.0, 1.0);
+}
+
+/**
+ * @brief Build the decode table for a joystick (if it has one). Folds in the scaling, 
+ * the AXIAL deadzone, and the response curve. Only called when the settings change.
+ * 
+ * @param side - Side of the joystick. (LEFT or RIGHT).
+ */
+void Controller::buildJoyTable(Dir side) {
+  CurveTable *table = joyTables[side];
+  
+  for (int i = 0; table && i < 256; i++) {
+    float val = (i / 127.5) - 1.0;
+    float mag = abs(val);
+    
+    if (deadzoneShape == AXIAL && mag < joyDeadzone) {
+      table->values[i] = 0;
+    } else {
+      float curved = applyCurve(*table, mag) * TABLE_ONE + 0.5;
+      table->values[i] = val < 0 ? -(int16_t)curved : (int16_t)curved;
+    }
+  }
+  
+  //redo the current values with the new settings (unless the failsafe has zeroed them)
+  if (receivedAny && !failsafeActive()) {
+    applyJoy(side);
+  }
+}
+
+/**
+ * @brief Build the decode table for a trigger (if it has one). Folds in the scaling and 
+ * the response curve. Only called when the settings change.
+ * 
+ * @param side - Side of the trigger. (LEFT or RIGHT).
+ */
+void Controller::buildTriggerTable(Dir side) {
+  CurveTable *table = triggerTables[side];
+  
+  for (int i = 0; table && i < 256; i++) {
+    table->values[i] = applyCurve(*table, i / 255.0) * TABLE_ONE + 0.5;
+  }
+  
+  //redo the current value with the new settings (unless the failsafe has zeroed it)
+  if (receivedAny && !failsafeActive()) {
+    triggers[side] = decodeTrigger(side, triggerRaw[side]);
+  }
 }
 
 /**
@@ -389,3 +1437,193 @@ bool Controller::getButtonClick(Dir side, uint8_t button) {
     
     return false;
 }
+
+/**
+ * @brief Add a gesture to watch for. The buttons are a mask made from the mask 
+ * functions, ex: bumperMask(LEFT) | bumperMask(RIGHT). The gesture types are:
+ *   - DOUBLE_CLICK: all of the buttons are pressed twice within time ms.
+ *   - HOLD: all of the buttons are held down for time ms.
+ *   - CHORD: all of the buttons are pressed together, with the first and last press 
+ *     within time ms of each other.
+ * 
+ * @param type - type of gesture. (DOUBLE_CLICK, HOLD, or CHORD).
+ * @param buttons - mask of the buttons in the gesture.
+ * @param time - time for the gesture in ms (see above).
+ * @return id of the gesture, or -1 if there is no more room.
+ */
+int8_t Controller::addGesture(GestureType type, uint16_t buttons, uint16_t time) {
+    if (numGestures >= MAX_GESTURES || buttons == 0) {
+        return -1;
+    }
+    
+    Gesture &newGesture = gestures[numGestures];
+    newGesture.type = type;
+    newGesture.buttons = buttons;
+    newGesture.time = time;
+    newGesture.start = 0;
+    newGesture.stage = GESTURE_IDLE;
+    newGesture.triggered = false;
+    
+    return numGestures++;
+}
+
+/**
+ * @brief Check if a gesture has happened. Like the click functions, this will return 
+ * true *once* for each time the gesture happens.
+ * 
+ * @param id - id of the gesture (from addGesture()).
+ * @return true if the gesture happened, false otherwise.
+ */
+bool Controller::gesture(int8_t id) {
+    if (id < 0 || id >= numGestures || !gestures[id].triggered) {
+        return false;
+    }
+    
+    gestures[id].triggered = false;
+    return true;
+}
+
+/**
+ * @brief Get a past state of the buttons from the history. A new state is added each 
+ * time any button changes. The left buttons are in the low byte and the right buttons 
+ * are in the high byte (same as the masks).
+ * 
+ * @param index - how far back to look. (0 is the newest, up to HISTORY_SIZE - 1).
+ * @param state - set to the button state.
+ * @param time - set to the time the state was received.
+ * @return true if there is a record at the index, false otherwise.
+ */
+bool Controller::buttonHistory(uint8_t index, uint16_t &state, uint32_t &time) {
+    if (index >= historyCount) {
+        return false;
+    }
+    
+    const ButtonRecord &record = history[(historyHead + HISTORY_SIZE - index) % HISTORY_SIZE];
+    state = record.state;
+    time = record.time;
+    return true;
+}
+
+/**
+ * @brief Get the gesture mask for a joystick button.
+ * 
+ * @param side - Side of the joystick. (LEFT or RIGHT).
+ * @return mask for the button.
+ */
+uint16_t Controller::joyButtonMask(Dir side) {
+    return (1 << JOY_BUTTON) << (side * 8);
+}
+
+/**
+ * @brief Get the gesture mask for a colored button (right side of the controller).
+ * 
+ * @param dir - Direction of the button. (UP, DOWN, LEFT, RIGHT).
+ * @return mask for the button.
+ */
+uint16_t Controller::buttonMask(Dir dir) {
+    return (1 << dir) << 8;
+}
+
+/**
+ * @brief Get the gesture mask for a dpad button (or the left side colored buttons on 
+ * older controller model).
+ * 
+ * @param dir - Direction of the Dpad button. (UP, DOWN, LEFT, RIGHT).
+ * @return mask for the button.
+ */
+uint16_t Controller::dpadMask(Dir dir) {
+    return 1 << dir;
+}
+
+/**
+ * @brief Get the gesture mask for a bumper.
+ * 
+ * @param side - Side of the bumper. (LEFT or RIGHT).
+ * @return mask for the button.
+ */
+uint16_t Controller::bumperMask(Dir side) {
+    return (1 << BUMPER) << (side * 8);
+}
+
+/**
+ * @brief Add the button state to the history if it changed, and step each gesture 
+ * using the change. This is only done when the buttons change, so it is a fixed 
+ * amount of work per packet.
+ * 
+ * @param time - time the button state was received.
+ */
+void Controller::recordButtons(uint32_t time) {
+    uint16_t state = buttons[LEFT] | (buttons[RIGHT] << 8);
+    uint16_t lastState = 0;
+    
+    if (historyCount > 0) {
+        lastState = history[historyHead].state;
+        if (state == lastState) {
+            return;
+        }
+    }
+    
+    //add to the ring
+    historyHead = (historyHead + 1) % HISTORY_SIZE;
+    history[historyHead].time = time;
+    history[historyHead].state = state;
+    if (historyCount < HISTORY_SIZE) {
+        historyCount++;
+    }
+    
+    //step the gestures
+    for (uint8_t i = 0; i < numGestures; i++) {
+        Gesture &cur = gestures[i];
+        bool wasDown = (lastState & cur.buttons) == cur.buttons;
+        bool isDown = (state & cur.buttons) == cur.buttons;
+        
+        switch (cur.type) {
+          case DOUBLE_CLICK:
+            if (isDown && !wasDown) {
+                if (cur.stage == GESTURE_STARTED && time - cur.start <= cur.time) {
+                    //second click in time
+                    cur.triggered = true;
+                    cur.stage = GESTURE_IDLE;
+                } else {
+                    //first click
+                    cur.stage = GESTURE_STARTED;
+                    cur.start = time;
+                }
+            }
+            break;
+          case HOLD:
+            if (isDown && !wasDown) {
+                cur.stage = GESTURE_STARTED;
+                cur.start = time;
+            } else if (!isDown) {
+                cur.stage = GESTURE_IDLE;
+            }
+            break;
+          case CHORD:
+            if (!(lastState & cur.buttons) && (state & cur.buttons)) {
+                //first button of the chord
+                cur.start = time;
+            }
+            if (isDown && !wasDown && time - cur.start <= cur.time) {
+                cur.triggered = true;
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Check if any of the held buttons have been held long enough.
+ * 
+ * @param now - the current time.
+ */
+void Controller::checkHolds(uint32_t now) {
+    for (uint8_t i = 0; i < numGestures; i++) {
+        Gesture &cur = gestures[i];
+        
+        if (cur.type == HOLD && cur.stage == GESTURE_STARTED && now - cur.start >= cur.time) {
+            cur.triggered = true;
+            cur.stage = GESTURE_DONE;
+        }
+    }
+}
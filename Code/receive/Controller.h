@@ -6,17 +6,38 @@
 #define CONTROLLER_H
 
 #include "Arduino.h"
+#include "ControllerFields.h"
 
 enum Dir { LEFT, RIGHT, UP, DOWN };
 enum Axis { X, Y };
+enum Field { JOY_DATA, TRIGGER_DATA, BUTTON_DATA };
+enum ConnectionState { CONNECTING, LIVE, DEGRADED, LOST };
+enum GestureType { DOUBLE_CLICK, HOLD, CHORD };
+enum Curve { LINEAR, EXPO, CUSTOM };
+enum DeadzoneShape { AXIAL, RADIAL };
+
+#define HISTORY_SIZE 16     //number of button states kept in the history
+#define MAX_GESTURES 8      //max number of gesture patterns
+#define MAX_CURVE_POINTS 9  //max number of points in a custom response curve
+#define DRAIN_BYTES 64      //default byte limit per receiveData() call in drain mode
+#define DRAIN_TIME 2        //default time limit (ms) per receiveData() call in drain mode
+#define MAX_TARGETS (12 + MAX_EXT_BYTES)  //max data bytes in a packet (plus the bitmap and CRC)
 
 class Controller {
 public:
     Controller(HardwareSerial &xbeeSerial);
+    ~Controller();
     
     void init();
     bool connected();
-    void setJoyDeadzone(float deadzone);
+    ConnectionState connectionState();
+    void setTimeouts(uint16_t degradedTimeout, uint16_t lostTimeout);
+    void setFailsafe(bool zeroOutputs);
+    void setJoyDeadzone(float deadzone, DeadzoneShape shape = AXIAL);
+    void setJoyCurve(Dir side, Curve curve, float expo = 0.0);
+    void setJoyCurve(Dir side, const float points[], uint8_t numPoints);
+    void setTriggerCurve(Dir side, Curve curve, float expo = 0.0);
+    void setTriggerCurve(Dir side, const float points[], uint8_t numPoints);
     
     float joystick(Dir side, Axis axis);
     float trigger(Dir side);
@@ -31,33 +52,154 @@ public:
     bool dpadClick(Dir dir);
     bool bumperClick(Dir side);
     
+    int8_t addGesture(GestureType type, uint16_t buttons, uint16_t time);
+    bool gesture(int8_t id);
+    bool buttonHistory(uint8_t index, uint16_t &state, uint32_t &time);
+    
+    static uint16_t joyButtonMask(Dir side);
+    static uint16_t buttonMask(Dir dir);
+    static uint16_t dpadMask(Dir dir);
+    static uint16_t bumperMask(Dir side);
+    
+    uint32_t dataAge(Field field, Dir side);
+    uint16_t latency();
+    uint16_t jitter();
+    uint16_t packetsLost();
+    bool inSync();
+    void setRefreshRequests(bool enabled);
+    
+    float field(ExtField field);
+    uint32_t fieldAge(ExtField field);
+    
     void receiveData();  //read data from the serial stream
+    void setDrain(bool drain, uint16_t maxBytes = DRAIN_BYTES, uint8_t maxTime = DRAIN_TIME);
   
 private:
     bool getButtonState(Dir side, uint8_t button);
     bool getButtonClick(Dir side, uint8_t button);
     
     void updateButtons(Dir side, uint8_t newVal);
+    void checkEdges(Dir side, uint16_t counts, bool haveButtons, uint32_t time);
+    bool edgeCheck(uint16_t counts, uint8_t mark);
+    void recordButtons(uint32_t time);
+    void checkHolds(uint32_t now);
     void updateJoy(Dir side, Axis axis, uint8_t newVal);
     void updateTrigger(Dir side, uint8_t newVal);
+    void applyJoy(Dir side);
+    
+    //response curve settings, and the decode table for the curve
+    struct CurveTable {
+        Curve curve;
+        float expo;
+        float points[MAX_CURVE_POINTS];
+        uint8_t numPoints;
+        int16_t values[256];
+    };
+    void setCurve(CurveTable *&table, Curve curve, float expo, const float points[], uint8_t numPoints);
+    float applyCurve(const CurveTable &table, float val);
+    void buildJoyTable(Dir side);
+    void buildTriggerTable(Dir side);
+    float decodeJoy(Dir side, uint8_t raw);
+    float decodeTrigger(Dir side, uint8_t raw);
+    bool failsafeActive();
 
-    int8_t getDataTargets(uint8_t dataTargets[], int8_t dataHeader);
+    int8_t getDataTargets(uint8_t dataTargets[], uint8_t dataHeader);
+    int8_t getExtTargets(uint8_t dataTargets[], uint8_t extBitmap);
+    void applyExt(uint8_t extBitmap, uint32_t receiveTime);
+    uint8_t receivePacket();
+    bool packetWaiting();
     bool isValidHeader(uint8_t header);
+    void updateStamp(uint16_t stamp, uint32_t receiveTime);
+    void checkDigest(uint8_t digest, uint32_t receiveTime);
+    void requestRefresh(uint32_t time);
+    void checkFailsafe();
     
     //controller data
     float joy[2][2];
     float triggers[2];
+    uint8_t joyRaw[2][2];      //last received joystick bytes
+    uint8_t triggerRaw[2];     //last received trigger bytes
+    uint8_t joyUpdated = 0;    //bit for each joystick side that got new bytes this packet
     uint8_t buttons[2];
     uint8_t buttonClicks[2];  //used for reading press events
+    uint16_t edgeCounts[2] = {0, 0};        //2-bit edge count for each button
+    bool edgesSynced[2] = {false, false};   //edge counts match the controller's (it is sending them)
+    
+    //extension fields
+    float extValues[NUM_EXT_FIELDS];
+    uint8_t extRaw[MAX_EXT_BYTES];           //last received bytes for each field
+    uint8_t extOffset[NUM_EXT_FIELDS];       //where each field starts in extRaw
+    uint32_t extReceive[NUM_EXT_FIELDS];     //when each field was last received
+    uint8_t extSeen = 0;                     //bitmap of fields received (for the digest)
+
+    //button history ring. Holds the button states (right in the high byte) each time they change.
+    struct ButtonRecord {
+        uint32_t time;
+        uint16_t state;
+    };
+    ButtonRecord history[HISTORY_SIZE];
+    uint8_t historyHead = 0;   //index of the newest record
+    uint8_t historyCount = 0;  //number of records in the ring
+
+    //gesture patterns
+    struct Gesture {
+        GestureType type;
+        uint16_t buttons;   //buttons in the pattern
+        uint16_t time;      //double click window, hold time, or chord window in ms
+        uint32_t start;     //time the pattern was started
+        uint8_t stage;      //progress through the pattern
+        bool triggered;     //pattern detected and not read yet
+    };
+    Gesture gestures[MAX_GESTURES];
+    uint8_t numGestures = 0;
 
     float joyDeadzone = 0.005; //give it a little initially to cover rounding error
+    DeadzoneShape deadzoneShape = AXIAL;
+    uint32_t radialDeadzone = 0;   //squared radial deadzone in the units of the raw bytes (x2)
+    
+    //decode tables, only for sides with a curve other than LINEAR (NULL otherwise). Each 
+    //received byte is looked up to get the value in 1/32767 units, with the deadzone (if 
+    //AXIAL) and the response curve already applied.
+    CurveTable *joyTables[2] = {NULL, NULL};
+    CurveTable *triggerTables[2] = {NULL, NULL};
+    
+    //connection state
+    uint16_t degradedTimeout;     //time without data before the connection is degraded
+    uint16_t lostTimeout;         //time without data before the connection is lost
+    bool failsafe = false;        //zero the outputs when the connection is lost
     
     //serial
     HardwareSerial &xbeeSerial;
 
     //variables for receiving data
-    uint8_t dataTargets[8];     //targets for the incoming data
+    uint8_t dataTargets[MAX_TARGETS];    //targets for the incoming data
     uint32_t lastReceive = 0;    //track when the last transmission was received
+    bool receivedAny = false;    //has any transmission been received
+    bool drain = false;          //read all waiting packets in each call
+    uint16_t drainBytes = DRAIN_BYTES;
+    uint8_t drainTime = DRAIN_TIME;
+    uint32_t fieldReceive[6];    //when each header field was last received
+    
+    //keepalive digest checks
+    bool stateInSync = false;     //last keepalive digest matched
+    uint8_t heldFields = 0;       //header fields zeroed by the failsafe and not received since
+    bool refreshRequests = false; //ask for a full send on a mismatch
+    uint32_t lastRequest = 0;     //time of the last refresh request
+    uint32_t lastListen = 0;      //time of the last LISTENING byte
+
+    //variables for tracking the sender stamps
+    bool stampSynced = false;      //have we started tracking the stamps
+    uint32_t lastStampReceive = 0; //when the last stamp was received
+    uint8_t lastSequence = 0;      //sequence number of the last stamp
+    bool sequenceJump = false;     //last stamp was far out of sequence (skipped)
+    uint16_t stampBase = 0;        //reference point for the clock offset (12-bit ms)
+    int16_t lastOffsetMin = 0;     //fastest transit in the previous window
+    int16_t offsetMin = 0;         //fastest transit in the current window
+    int16_t lastTransit = 0;       //transit of the last stamp (relative to stampBase)
+    uint8_t windowCount = 0;       //number of stamps in the current window
+    int32_t latencyAvg = 0;        //smoothed latency (1/16 ms)
+    int32_t jitterAvg = 0;         //smoothed jitter (1/16 ms)
+    uint16_t lostCount = 0;        //number of packets skipped in the sequence
 };
 
 
@@ -11,6 +11,9 @@
 
 bool disconnected = false;
 
+//ids for the gesture demo
+int8_t doubleClickId, holdId, chordId;
+
 //Create the communications object. Use Serial for the communications.
 Controller controller(Serial3);
 
@@ -28,15 +31,29 @@ void setup() {
   //initialize the receiver
   controller.init();
   Serial.println("Waiting for connection...");
-  while (!controller.connected()) { delay(10); }
+  while (!controller.connected()) { 
+    controller.receiveData();
+    delay(10); 
+  }
   Serial.println("Connected...");
 
   //set a deadzone for the joysticks
   controller.setJoyDeadzone(0.08);
+
+  //stop everything if the connection is lost
+  controller.setFailsafe(true);
+
+  //gestures for the gesture demo
+  doubleClickId = controller.addGesture(DOUBLE_CLICK, Controller::buttonMask(UP), 400);
+  holdId = controller.addGesture(HOLD, Controller::buttonMask(DOWN), 1000);
+  chordId = controller.addGesture(CHORD, Controller::bumperMask(LEFT) | Controller::bumperMask(RIGHT), 100);
 }
 
 //=====MAIN LOOP=============================================
 void loop() {
+  //read any new data
+  controller.receiveData();
+  
   //Uncomment a demo mode to run it.
   if (controller.connected()) {
     //Print all values to the serial monitor
@@ -44,6 +61,12 @@ void loop() {
   
     //only print button changes (clicks)
     //printButtonChanges();
+
+    //print gestures (double click UP, hold DOWN, or press both bumpers)
+    //printGestures();
+    
+    //print the data age and link latency (turn on stamping in the sender)
+    //printLinkStats();
     
     disconnected = false;
   } else {
@@ -104,6 +127,47 @@ void printButtonChanges() {
   }
 }
 
+/**
+ * Display when one of the gestures happens.
+ */
+void printGestures() {
+  if (controller.gesture(doubleClickId)) {
+    Serial.println("gesture:DOUBLE_CLICK");
+  }
+  if (controller.gesture(holdId)) {
+    Serial.println("gesture:HOLD");
+  }
+  if (controller.gesture(chordId)) {
+    Serial.println("gesture:CHORD");
+  }
+}
+
+/**
+ * Display how fresh the data is and how the link is doing.
+ */
+void printLinkStats() {
+  static unsigned long lastPrint = millis();
+  
+  if (millis() - lastPrint > 500) {
+    //Format:
+    //age:[joyL,joyR,but],lat:latency,jit:jitter,lost:lost
+    Serial.print("age:[");
+    Serial.print(controller.dataAge(JOY_DATA, LEFT));
+    Serial.print(",");
+    Serial.print(controller.dataAge(JOY_DATA, RIGHT));
+    Serial.print(",");
+    Serial.print(controller.dataAge(BUTTON_DATA, RIGHT));
+    Serial.print("],lat:");
+    Serial.print(controller.latency());
+    Serial.print(",jit:");
+    Serial.print(controller.jitter());
+    Serial.print(",lost:");
+    Serial.println(controller.packetsLost());
+    
+    lastPrint = millis();
+  }
+}
+
 /**
  * Spam all of the controller values unto the screen.
  */
@@ -6,6 +6,7 @@
  */
  
 #include "Controller.h"
+#include "Scheduler.h"
 
 //Define pins
 #define JOY_L_Y_PIN     A1
@@ -28,9 +29,17 @@
 //range for joystick values
 #define JOY_RANGE 1022
 
+//task periods in ms
+#define STICK_PERIOD   5   //200Hz
+#define BUTTON_PERIOD  10  //100Hz
+#define LINK_PERIOD    5
+
 //Create the communications object. Use Serial for the communications.
 Controller controller(Serial);
 
+//Runs the reading and sending tasks
+Scheduler scheduler;
+
 void setup() {
   //initialize pins
   pinMode(JOY_L_Y_PIN, INPUT); //joystick
@@ -50,9 +59,21 @@ void setup() {
 
   //initialize the communications
   controller.init();
+
+  //add the tasks
+  scheduler.addTask(readSticks, STICK_PERIOD);
+  scheduler.addTask(readButtons, BUTTON_PERIOD);
+  scheduler.addTask(updateLink, LINK_PERIOD);
 }
 
 void loop() {
+  scheduler.run();
+}
+
+/**
+ * Read all of the buttons.
+ */
+void readButtons() {
   //Right set of buttons
   controller.setButton(LEFT,  digitalRead(BUT_R_L_PIN));
   controller.setButton(RIGHT, digitalRead(BUT_R_R_PIN));
@@ -64,14 +85,23 @@ void loop() {
   controller.setDpad(RIGHT, digitalRead(BUT_L_R_PIN));
   controller.setDpad(UP,    digitalRead(BUT_L_U_PIN));
   controller.setDpad(DOWN,  digitalRead(BUT_L_D_PIN));
+}
 
+/**
+ * Read the joysticks.
+ */
+void readSticks() {
   //joystick values.
   controller.setJoystick(LEFT, X, scaleJoy(analogRead(JOY_L_X_PIN)));
   controller.setJoystick(LEFT, Y, scaleJoy(analogRead(JOY_L_Y_PIN)));
   controller.setJoystick(RIGHT, X, scaleJoy(analogRead(JOY_R_X_PIN)));
   controller.setJoystick(RIGHT, Y, scaleJoy(analogRead(JOY_R_Y_PIN)));
+}
 
-  //do an update
+/**
+ * Send any updates.
+ */
+void updateLink() {
   controller.update();
 }
 
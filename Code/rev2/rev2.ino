@@ -16,6 +16,7 @@
  
 #include "Controller.h"
 #include "Debouncer.h"
+#include "Scheduler.h"
 
 //=====DEFINE PINS========================================
 //---Joystick pins----
@@ -40,6 +41,11 @@
 //range for joystick values
 #define JOY_RANGE 1023
 
+//task periods in ms
+#define STICK_PERIOD   5   //200Hz
+#define BUTTON_PERIOD  5   //200Hz (the debouncer needs a steady value for 10ms)
+#define LINK_PERIOD    5
+
 //button enums
 //Left side buttons
 enum {LEFT_JOY, DPAD_DOWN, DPAD_LEFT, DPAD_UP, DPAD_RIGHT};
@@ -64,6 +70,9 @@ Debouncer rightButtons(rightThresholds, 5, RIGHT_BUTTONS);
 Debouncer leftButtons(leftThresholds, 5, LEFT_BUTTONS);
 Debouncer otherButtons(otherThresholds, 4, OTHER_BUTTONS);
 
+//Runs the reading and sending tasks
+Scheduler scheduler;
+
 
 //=====SETUP========================================
 void setup() {
@@ -97,10 +106,27 @@ void setup() {
 
   //initialize the communications
   controller.init();
+
+  //add the tasks
+  scheduler.addTask(readSticks, STICK_PERIOD);
+  scheduler.addTask(readButtons, BUTTON_PERIOD);
+  scheduler.addTask(updateLink, LINK_PERIOD);
+
+  //Uncomment to print the loop timing over USB (the xbee is on Serial1)
+  //Serial.begin(115200);
+  //scheduler.addTask(printTiming, 1000);
 }
 
 //=====MAIN LOOP========================================
 void loop() {
+    scheduler.run();
+}
+
+//=====TASKS========================================
+/**
+ * Read all of the button sets.
+ */
+void readButtons() {
     //read the button sets
     int rightButtonPress = rightButtons.getPressed();
     int leftButtonPress = leftButtons.getPressed();
@@ -123,19 +149,31 @@ void loop() {
     controller.setBumper(RIGHT, otherButtonPress == RIGHT_BUMP);
     controller.setTrigger(LEFT, (otherButtonPress == LEFT_TRIG ? 1.0 : 0.0));
     controller.setTrigger(RIGHT, (otherButtonPress == RIGHT_TRIG ? 1.0 : 0.0));
+}
 
-
+/**
+ * Read the joysticks.
+ */
+void readSticks() {
     //joystick values. Scale the analog values from 1023 down to 1.0.
     controller.setJoystick(LEFT, X, scaleJoy(analogRead(JOY_L_X)));
     controller.setJoystick(LEFT, Y, scaleJoy(analogRead(JOY_L_Y)));
     controller.setJoystick(RIGHT, X, scaleJoy(analogRead(JOY_R_X) - 40)); // this one is stupid for some reason
     controller.setJoystick(RIGHT, Y, scaleJoy(analogRead(JOY_R_Y)));
+}
 
-
-    //do an update
+/**
+ * Send any updates.
+ */
+void updateLink() {
     controller.update();
+}
 
-    delay(1);
+/**
+ * Print the task timing.
+ */
+void printTiming() {
+    scheduler.printStats(Serial);
 }
 
 
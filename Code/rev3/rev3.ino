@@ -13,13 +13,13 @@
 | C3 | Right Bump   | Left Bump   | Left Joy    | Right Joy |
 +----+--------------+-------------+-------------+-----------+
  * This does have the side effct however, that when sending a pulse to the set of buttons it
- * takes time for things to settle down. Because of this, there is a delay of 10ms in the 
- * below code. Removing or lowering delay can cause mis-reads, no-reads, and/or possible 
- * heart failure.
+ * takes time for things to settle down. Because of this, only one bank is read every 10ms 
+ * (READ_SPACING). Lowering this can cause mis-reads, no-reads, and/or possible heart failure.
  *
  */
  
 #include "Controller.h"
+#include "Scheduler.h"
 
 
 //=====DEFINE PINS========================================
@@ -84,9 +84,17 @@
 //When we send power to the bank, it takes time for things to settle...
 #define READ_SPACING 10  
 
+//task periods in ms
+#define STICK_PERIOD   5   //200Hz
+#define BUTTON_PERIOD  READ_SPACING  //one bank per run
+#define LINK_PERIOD    5
+
 //Create the communications object. Use Serial for the communications.
 Controller controller(Serial);
 
+//Runs the reading and sending tasks
+Scheduler scheduler;
+
 
 //=====SETUP========================================
 void setup() {
@@ -121,10 +129,23 @@ void setup() {
 
   //initialize the communications
   controller.init();
+
+  //add the tasks
+  scheduler.addTask(readSticks, STICK_PERIOD);
+  scheduler.addTask(readButtonBank, BUTTON_PERIOD);
+  scheduler.addTask(updateLink, LINK_PERIOD);
 }
 
 //=====MAIN LOOP========================================
 void loop() {
+  scheduler.run();
+}
+
+//=====TASKS========================================
+/**
+ * Read the joysticks and triggers.
+ */
+void readSticks() {
   //joystick values. Scale the analog values from 1023 down to 1.0.
   controller.setJoystick(LEFT, X, scaleJoy(analogRead(JOY_L_X)));
   controller.setJoystick(LEFT, Y, scaleJoy(analogRead(JOY_L_Y)));
@@ -134,40 +155,56 @@ void loop() {
   //trigger values. Scale the analog values from 1023 down to 1.0.
   controller.setTrigger(LEFT, scaleTrigger(analogRead(TRIG_LEFT), LEFT_TRIG_MIN, LEFT_TRIG_MAX));
   controller.setTrigger(RIGHT, scaleTrigger(analogRead(TRIG_RIGHT), RIGHT_TRIG_MIN, RIGHT_TRIG_MAX));
+}
 
-  //First bank of buttons
-  digitalWrite(BR_DD_RB, HIGH);
-  controller.setBumper(RIGHT, digitalRead(BUMP_R));
-  controller.setButton(RIGHT, digitalRead(BTN_RIGHT));
-  controller.setDpad(DOWN, digitalRead(DPAD_DOWN));
-  digitalWrite(BR_DD_RB, LOW);
-  delay(READ_SPACING);
-
-  //Second bank of buttons
-  digitalWrite(BL_DR_LB, HIGH);
-  controller.setBumper(LEFT, digitalRead(BUMP_L));
-  controller.setButton(LEFT, digitalRead(BTN_LEFT));
-  controller.setDpad(RIGHT, digitalRead(DPAD_RIGHT));
-  digitalWrite(BL_DR_LB, LOW);
-  delay(READ_SPACING);
-  
-  //Third bank of buttons
-  digitalWrite(BD_DL_LJ, HIGH);
-  controller.setJoyButton(LEFT, digitalRead(JOY_L_BTN));
-  controller.setButton(DOWN, digitalRead(BTN_DOWN));
-  controller.setDpad(LEFT, digitalRead(DPAD_LEFT));
-  digitalWrite(BD_DL_LJ, LOW);
-  delay(READ_SPACING);
-  
-  //Fourth bank of buttons
-  digitalWrite(BU_DU_RJ, HIGH);
-  controller.setJoyButton(RIGHT, digitalRead(JOY_R_BTN));
-  controller.setButton(UP, digitalRead(BTN_UP));
-  controller.setDpad(UP, digitalRead(DPAD_UP));
-  digitalWrite(BU_DU_RJ, LOW);
-  delay(READ_SPACING);
-
-  //do an update
+/**
+ * Read the next bank of buttons. The banks take turns so each one has time to settle.
+ */
+void readButtonBank() {
+  static uint8_t bank = 0;
+
+  switch (bank) {
+    case 0:
+      //First bank of buttons
+      digitalWrite(BR_DD_RB, HIGH);
+      controller.setBumper(RIGHT, digitalRead(BUMP_R));
+      controller.setButton(RIGHT, digitalRead(BTN_RIGHT));
+      controller.setDpad(DOWN, digitalRead(DPAD_DOWN));
+      digitalWrite(BR_DD_RB, LOW);
+      break;
+    case 1:
+      //Second bank of buttons
+      digitalWrite(BL_DR_LB, HIGH);
+      controller.setBumper(LEFT, digitalRead(BUMP_L));
+      controller.setButton(LEFT, digitalRead(BTN_LEFT));
+      controller.setDpad(RIGHT, digitalRead(DPAD_RIGHT));
+      digitalWrite(BL_DR_LB, LOW);
+      break;
+    case 2:
+      //Third bank of buttons
+      digitalWrite(BD_DL_LJ, HIGH);
+      controller.setJoyButton(LEFT, digitalRead(JOY_L_BTN));
+      controller.setButton(DOWN, digitalRead(BTN_DOWN));
+      controller.setDpad(LEFT, digitalRead(DPAD_LEFT));
+      digitalWrite(BD_DL_LJ, LOW);
+      break;
+    case 3:
+      //Fourth bank of buttons
+      digitalWrite(BU_DU_RJ, HIGH);
+      controller.setJoyButton(RIGHT, digitalRead(JOY_R_BTN));
+      controller.setButton(UP, digitalRead(BTN_UP));
+      controller.setDpad(UP, digitalRead(DPAD_UP));
+      digitalWrite(BU_DU_RJ, LOW);
+      break;
+  }
+
+  bank = (bank + 1) % 4;
+}
+
+/**
+ * Send any updates.
+ */
+void updateLink() {
   controller.update();
 }
 
@@ -3,10 +3,15 @@
  * 
  * Any time a value is changed, a bit is set in the transmission header. When the update() 
  * function is called, we check if we should send. Sending logic:
- *   - time since full send > max interval: send all data
+ *   - refresh requested by the receiver, or time since full send > full interval: send all data
+ *     (the full interval is FULL_INTERVAL if the receiver can ask for refreshes, or the 
+ *     refresh interval if it hasn't been heard from)
  *   - non-analog value changed and time > min interval: send data indicated by dataHeader
- *   - any value changed and time > analog interval: send data indicated by dataHeader
+ *   - time since full send or keepalive > refresh interval: send a keepalive
+ *   - any value changed (or button edges to repeat) and time > analog interval: send data indicated by dataHeader
  *   - else: nope
+ * 
+ * If keepalives are turned off, a full send is done every refresh interval instead.
  *   
  * The transmission is as follows:
  * +--------+-------+-------+-------+-------+----------+-----------+---------+----------+
@@ -23,10 +28,36 @@
  * | 3 | Trig Right    |
  * | 4 | Buttons Left  |
  * | 5 | Buttons Right |
- * | 6 | -             |
- * | 7 | -             |
+ * | 6 | Stamp         |
+ * | 7 | Extension     |
  * +---+---------------+
  * 
+ * If the extension bit is set, a bitmap of extension fields follows the header and the 
+ * field data comes after the rest of the data, followed by a CRC-8 of the whole packet. 
+ * See ControllerFields.h.
+ * 
+ * If the stamp bit is set, two stamp bytes follow the header (before the data). The top 
+ * 4 bits are a sequence number and the bottom 12 bits are the sender time in ms:
+ * +-----------------+-----------------+
+ * |     stamp hi    |     stamp lo    |
+ * +-----------------+-----------------+
+ * | seq[3:0] t[11:8]|      t[7:0]     |
+ * +-----------------+-----------------+
+ * 
+ * A header of only the stamp bit (a stamp with no data is never sent) is a keepalive. It is 
+ * followed by a digest (CRC-8) of the 8 data bytes as they were last sent, then the bytes of 
+ * any digital extension fields that have been sent (except the button edge counts). Last is 
+ * a CRC-8 of the header and digest, so a stray byte can't pass as a keepalive. The receiver 
+ * compares the digest to a digest of what it has. If they don't match, the receiver sends 
+ * back REFRESH_REQUEST to ask for a full send. A receiver that sends requests also sends 
+ * LISTENING back every few seconds. Until that is heard (or if it stops), the receiver may 
+ * not be able to ask, so a full send is done every refresh interval like before.
+ * +--------+--------+--------+
+ * |   0    |   1    |   2    |
+ * +--------+--------+--------+
+ * |  0x40  | digest |  CRC   |
+ * +--------+--------+--------+
+ * 
  * The buttons are split into left and right. The buttons for a side are indicated by bits as follows:
  * +---+--------------+
  * | 0 | Left Button  |
@@ -53,6 +84,14 @@
 #define MIN_INTERVAL 20
 #define ANALOG_INTERVAL 50
 #define MAX_INTERVAL 800
+#define FULL_INTERVAL 5000  //full send backstop when keepalives are on
+
+//button bytes per side that carry the counts-off marker after redundancy is turned off
+#define EDGE_OFF_SENDS 5
+
+//bytes the receiver sends back: ask for a full send, and "requests will get through"
+#define REFRESH_REQUEST 0xA5
+#define LISTENING 0x5A
 
 //Define bit offsets for the header. Left/right are specified using the Dir enum.
 const uint8_t JOY        = 1 << 0;
@@ -62,6 +101,13 @@ const uint8_t NON_ANALOG = BUTTONS | (BUTTONS << 1);
 const uint8_t ALL        = 0b00111111;
 const uint8_t LEFT_HALF    = JOY | BUTTONS | TRIGGER;
 const uint8_t RIGHT_HALF = (JOY << 1) | (BUTTONS << 1) | (TRIGGER << 1);
+const uint8_t STAMP      = 1 << 6;
+const uint8_t EXTENDED   = 1 << 7;
+
+//header bit for each of the 8 data bytes
+const uint8_t STATE_BITS[8] = { JOY << LEFT, JOY << LEFT, JOY << RIGHT, JOY << RIGHT, 
+                                TRIGGER << LEFT, TRIGGER << RIGHT, BUTTONS << LEFT, BUTTONS << RIGHT };
+const uint8_t KEEPALIVE  = STAMP;  //a stamp with no data
 
 
 //Define offsets for buttons (the rest are in enums).
@@ -70,12 +116,30 @@ const uint8_t BUMPER      = 5;
 
 /** Constructor for the class.
 */
-Controller::Controller(HardwareSerial &xbeeSerial) : xbeeSerial(xbeeSerial) { }
+Controller::Controller(HardwareSerial &xbeeSerial) : xbeeSerial(xbeeSerial), refreshInterval(MAX_INTERVAL) {
+    //start with everything zeroed (in case this isn't a global)
+    for (int i = 0; i < 2; i++) {
+        joy[i][X] = 0.0;
+        joy[i][Y] = 0.0;
+        triggers[i] = 0.0;
+        buttons[i] = 0;
+    }
+    
+    for (int i = 0; i < NUM_EXT_FIELDS; i++) {
+        extValues[i] = 0;
+        if (extFields[i].digital) {
+            extDigital |= 1 << i;
+        }
+    }
+}
 
 /** Initialize communications.
 */
 void Controller::init() {
     xbeeSerial.begin(BAUDRATE);
+    
+    //start with a full send so a receiver that was already running gets everything
+    refreshRequested = true;
 }
 
 /**
@@ -152,6 +216,113 @@ void Controller::setTrigger(Dir side, float value) {
     }
 }
 
+/**
+* Set the value of an extension field. The value is rounded to the field's scale and 
+* clamped to what its encoding can hold (see ControllerFields.h). Fields are only sent 
+* once they have been set.
+*
+* @param field - The extension field.
+* @param value - Value for the field in its units.
+*/
+void Controller::setField(ExtField field, float value) {
+    const FieldInfo &info = extFields[field];
+    int32_t count = lround(value / info.scale);
+    
+    //clamp to the encoding
+    switch (info.encoding) {
+      case FIELD_U8:
+        count = constrain(count, 0, 255);
+        break;
+      case FIELD_S8:
+        count = constrain(count, -128, 127);
+        break;
+      case FIELD_U16:
+        count = constrain(count, 0, 65535);
+        break;
+      case FIELD_S16:
+        count = constrain(count, -32768, 32767);
+        break;
+    }
+    
+    //Update if new value
+    if (count != extValues[field] || !(extUsed & (1 << field))) {
+        extValues[field] = count;
+        extUsed |= 1 << field;
+        
+        //Update the header and bitmap to specify this field should send
+        extHeader |= 1 << field;
+        dataHeader |= EXTENDED;
+    }
+}
+
+/**
+* Turn the packet stamp on or off. When on, each packet carries the sender time and a 
+* sequence number so the receiver can track latency, jitter, and lost packets.
+* Receivers older than the stamp bit will reject stamped packets.
+*
+* @param enabled - true to stamp packets. (Off by default).
+*/
+void Controller::setStamping(bool enabled) {
+    stamping = enabled;
+}
+
+/**
+* Set the max time between keepalives (or full sends if keepalives are off). The 
+* receiver can only notice a lost connection after this much silence, so lower this 
+* for a faster failsafe. Packets are at least MIN_INTERVAL apart, so values under that 
+* just send constantly.
+*
+* @param interval - max time between keepalives in ms. (Default is MAX_INTERVAL).
+*/
+void Controller::setRefreshInterval(uint16_t interval) {
+    refreshInterval = interval;
+}
+
+/**
+* Turn keepalives on or off. When on, a 3 byte keepalive with a digest of the last sent 
+* values is sent every refresh interval instead of all of the data. Full sends only 
+* happen when the receiver asks for one (its values don't match the digest) or every 
+* FULL_INTERVAL. That needs a receiver that can send requests back, so until one is 
+* heard from (LISTENING), there is still a full send every refresh interval. When off, 
+* all of the data is sent every refresh interval. Turn this off for receivers older than 
+* the keepalive.
+*
+* @param enabled - true to send keepalives. (On by default).
+*/
+void Controller::setKeepalive(bool enabled) {
+    keepalive = enabled;
+}
+
+/**
+* Set how many times button edges are repeated. Each button has a 2-bit count of its 
+* edges. After a button changes, the counts for that side go out (as the BUTTON_EDGES 
+* extension field) in the packet with the change and the next repeats packets. They ride 
+* along with whatever goes next, and if nothing else changes they go on their own every 
+* ANALOG_INTERVAL. The receiver uses the counts to replay any edges it missed, so a press 
+* is only lost if all of those packets are lost.
+* The counts also go with every other button byte (like in a full send), and every packet 
+* with counts ends in a CRC. Once the receiver has seen counts for a side, it only takes 
+* button bytes that come with them, so bytes from a packet that lost a byte can't fake a 
+* press. Costs 2 bytes per side (plus the bitmap and CRC bytes) in each of those packets.
+* Turning this off while running sends the next EDGE_OFF_SENDS button bytes for each side 
+* with the counts marked as stopped (EDGE_OFF), which tells the receiver to take plain 
+* button bytes again.
+*
+* @param repeats - number of extra packets to carry the edges. (0 turns this off, the default).
+*/
+void Controller::setRedundancy(uint8_t repeats) {
+    for (int side = LEFT; side <= RIGHT; side++) {
+        if (redundancy && !repeats) {
+            edgeRepeats[side] = 0;
+            edgesOff[side] = EDGE_OFF_SENDS;
+        } else if (repeats) {
+            edgesOff[side] = 0;
+        }
+    }
+    
+    redundancy = repeats;
+}
+
 /**
 * Set the value of a button.
 *
@@ -174,9 +345,34 @@ void Controller::updateButtonState(Dir side, uint8_t button, bool isPressed) {
         
         //Update the header to specify this item should send
         dataHeader |= (BUTTONS << side);
+        
+        //count the edge (2 bits per button) and repeat the counts in the next packets
+        uint16_t count = ((edgeCounts[side] >> (button * 2)) + 1) & 0b11;
+        edgeCounts[side] = (edgeCounts[side] & ~(0b11 << (button * 2))) | (count << (button * 2));
+        if (redundancy) {
+            edgeRepeats[side] = redundancy + 1;
+        }
     }
 }
 
+//CRC-8 (polynomial 0x07) of each 4-bit value, for crc8()
+const uint8_t CRC_NIBBLES[16] = { 0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 
+                                   0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D };
+
+/**
+* Add a byte to a CRC-8 (polynomial 0x07), a nibble at a time.
+*
+* @param crc - the CRC so far.
+* @param val - the byte to add.
+* @return the new CRC.
+*/
+uint8_t crc8(uint8_t crc, uint8_t val) {
+    crc ^= val;
+    crc = (crc << 4) ^ CRC_NIBBLES[crc >> 4];
+    crc = (crc << 4) ^ CRC_NIBBLES[crc >> 4];
+    return crc;
+}
+
 //For debugging
 void printBinary(uint8_t val) {
   for (int i = 7; i >= 0; i--) {
@@ -192,21 +388,52 @@ void printBinary(int val) {
 /** Send the updated values.
 * 
 * Look at changed values and decide what to send. Logic:
-*   - time since full send > max interval: send all data
+*   - refresh requested, or time since full send > full interval: send all data
+*     (FULL_INTERVAL if the receiver has been heard from recently, otherwise the refresh interval)
 *   - non-analog value changed and time > min interval: send data indicated by dataHeader
-*   - any value changed and time > analog interval: send data indicated by dataHeader
+*   - time since full send or keepalive > refresh interval: send a keepalive
+*   - any value changed (or button edges to repeat) and time > analog interval: send data indicated by dataHeader
 *   - else: nope
+* 
+* Any refresh requests from the receiver are read here too.
 */
 void Controller::update() {
     int timeDiff = millis() - lastSend;
+    
+    //check if the receiver wants a full send (or is there to ask for one)
+    while (xbeeSerial.available()) {
+      uint8_t val = xbeeSerial.read();
+      if (val == REFRESH_REQUEST) {
+        refreshRequested = true;
+      }
+      if (val == REFRESH_REQUEST || val == LISTENING) {
+        //the full sends are about to slow down to FULL_INTERVAL, so bring a receiver that 
+        //just showed up (or came back) up to date now
+        if (!heardReceiver || millis() - lastHeard >= FULL_INTERVAL) {
+          refreshRequested = true;
+        }
+        lastHeard = millis();
+        heardReceiver = true;
+      }
+    }
+    
+    //keepalives can only stand in for full sends if the receiver can ask for a refresh
+    bool canRequest = heardReceiver && millis() - lastHeard < FULL_INTERVAL;
+    uint16_t fullInterval = (keepalive && canRequest) ? FULL_INTERVAL : refreshInterval;
 
     //only send if past the minimum send interval
     if (timeDiff > MIN_INTERVAL) {
-      //send all values once every certain interval
-      if (millis() - lastFullSend > MAX_INTERVAL) {
+      //send all values once every certain interval (or when asked)
+      if (refreshRequested || millis() - lastFullSend > fullInterval) {
         fullSend();
-      //send button press immediately or analog change once every interval
-      } else if ((dataHeader & NON_ANALOG) || (dataHeader && timeDiff > ANALOG_INTERVAL)) {
+      //send button press immediately
+      } else if ((dataHeader & NON_ANALOG) || (extHeader & extDigital)) {
+        send();
+      //let the receiver check its values
+      } else if (keepalive && millis() - lastDigest > refreshInterval) {
+        sendKeepalive();
+      //analog change (or edge counts to repeat) once every interval
+      } else if ((dataHeader || edgeRepeats[LEFT] || edgeRepeats[RIGHT]) && timeDiff > ANALOG_INTERVAL) {
         send();
       }
     }
@@ -218,9 +445,17 @@ void Controller::fullSend() {
     //Update the header to specify that left half should send
     dataHeader |= LEFT_HALF;
     
+    //and the extension fields
+    if (extUsed) {
+        extHeader |= extUsed;
+        dataHeader |= EXTENDED;
+    }
+    
     //Send the data
     send();
     lastFullSend = millis();
+    lastDigest = millis();
+    refreshRequested = false;
 
     //update the header to specify right half should send.
     //it will send as soon as the min interval has passed.
@@ -234,87 +469,203 @@ void Controller::fullSend() {
 * describe which values will be sent.
 */
 void Controller::send() {
+    uint16_t stamp = 0;
+
+    //carry the button edge counts until they have been repeated enough. With redundancy 
+    //on, they also go with every button byte (full sends too) so the receiver can tell 
+    //real button bytes from shifted ones. Just after it is turned off, the button bytes 
+    //carry the counts marked as stopped instead.
+    for (int side = LEFT; side <= RIGHT; side++) {
+        bool hasButtons = dataHeader & (BUTTONS << side);
+        bool off = edgesOff[side] && hasButtons;
+        if (edgeRepeats[side] || (redundancy && hasButtons) || off) {
+            uint16_t counts = edgeCounts[side];
+            uint8_t check = (counts ^ (counts >> 4) ^ (counts >> 8) ^ (off ? EDGE_OFF : EDGE_CHECK)) & 0x0F;
+            extValues[BUTTON_EDGES_L + side] = counts | (check << 12);
+            extHeader |= 1 << (BUTTON_EDGES_L + side);
+            dataHeader |= EXTENDED;
+            if (edgeRepeats[side]) {
+                edgeRepeats[side]--;
+            }
+            if (off) {
+                edgesOff[side]--;
+            }
+        }
+    }
+
+    //add the stamp
+    if (stamping) {
+        dataHeader |= STAMP;
+        stamp = ((uint16_t)sequence << 12) | (millis() & 0x0FFF);
+        sequence = (sequence + 1) & 0x0F;
+    }
+
+    //save the bytes being sent for the keepalive digest
+    if (dataHeader & (JOY << LEFT)) {
+        sentState[0] = joyByte(LEFT, X);
+        sentState[1] = joyByte(LEFT, Y);
+    }
+    if (dataHeader & (JOY << RIGHT)) {
+        sentState[2] = joyByte(RIGHT, X);
+        sentState[3] = joyByte(RIGHT, Y);
+    }
+    if (dataHeader & (TRIGGER << LEFT)) {
+        sentState[4] = triggerByte(LEFT);
+    }
+    if (dataHeader & (TRIGGER << RIGHT)) {
+        sentState[5] = triggerByte(RIGHT);
+    }
+    if (dataHeader & (BUTTONS << LEFT)) {
+        sentState[6] = buttons[LEFT];
+    }
+    if (dataHeader & (BUTTONS << RIGHT)) {
+        sentState[7] = buttons[RIGHT];
+    }
+    
+    //and the extension field bytes (high byte first)
+    if (dataHeader & EXTENDED) {
+        uint8_t offset = 0;
+        for (int i = 0; i < NUM_EXT_FIELDS; i++) {
+            uint8_t width = extFields[i].width;
+            if (extHeader & (1 << i)) {
+                for (int j = 0; j < width; j++) {
+                    sentExt[offset + j] = extValues[i] >> (8 * (width - 1 - j));
+                }
+            }
+            offset += width;
+        }
+        extSent |= extHeader;
+    }
 
 #ifndef DEBUG_MODE  //transmit normally
     //send the header
     xbeeSerial.write((uint8_t*)&dataHeader, 1);
     
+    //extension bitmap
+    if (dataHeader & EXTENDED) {
+        xbeeSerial.write(extHeader);
+    }
+    
+    //stamp
+    if (dataHeader & STAMP) {
+        xbeeSerial.write((uint8_t)(stamp >> 8));
+        xbeeSerial.write((uint8_t)(stamp & 0xFF));
+    }
+    
     //Decide what data to send and send it
     //left joystick
     if (dataHeader & (JOY << LEFT)) {
-        xbeeSerial.write((uint8_t)((joy[LEFT][X] + 1.0) * 127.5));
-        xbeeSerial.write((uint8_t)((joy[LEFT][Y] + 1.0) * 127.5));
+        xbeeSerial.write(sentState[0]);
+        xbeeSerial.write(sentState[1]);
     }
     
     //right joysticks
     if (dataHeader & (JOY << RIGHT)) {
-        xbeeSerial.write((uint8_t)((joy[RIGHT][X] + 1.0) * 127.5));
-        xbeeSerial.write((uint8_t)((joy[RIGHT][Y] + 1.0) * 127.5));
+        xbeeSerial.write(sentState[2]);
+        xbeeSerial.write(sentState[3]);
     }
     
     //left trigger
     if (dataHeader & (TRIGGER << LEFT)) {
-        xbeeSerial.write((uint8_t)(triggers[LEFT] * 255));
+        xbeeSerial.write(sentState[4]);
     }
     
     //right trigger
     if (dataHeader & (TRIGGER << RIGHT)) {
-        xbeeSerial.write((uint8_t)(triggers[RIGHT] * 255));
+        xbeeSerial.write(sentState[5]);
     }
     
     //left button set
     if (dataHeader & (BUTTONS << LEFT)) {
-        xbeeSerial.write((uint8_t*)&buttons[LEFT], 1);
+        xbeeSerial.write(sentState[6]);
     }
     
     //right button set
     if (dataHeader & (BUTTONS << RIGHT)) {
-        xbeeSerial.write((uint8_t*)&buttons[RIGHT], 1);
+        xbeeSerial.write(sentState[7]);
+    }
+    
+    //extension fields (high byte first), then the packet CRC
+    if (dataHeader & EXTENDED) {
+        uint8_t offset = 0;
+        for (int i = 0; i < NUM_EXT_FIELDS; i++) {
+            if (extHeader & (1 << i)) {
+                xbeeSerial.write(&sentExt[offset], extFields[i].width);
+            }
+            offset += extFields[i].width;
+        }
+        xbeeSerial.write(packetCheck(stamp));
     }
 
 #else  //send in human-readable text
     //send the header
     printBinary(dataHeader);
     
+    //extension bitmap
+    if (dataHeader & EXTENDED) {
+        xbeeSerial.print(",");
+        printBinary(extHeader);
+    }
+    
+    //stamp
+    if (dataHeader & STAMP) {
+        xbeeSerial.print(",");
+        xbeeSerial.print(stamp >> 12);
+        xbeeSerial.print(":");
+        xbeeSerial.print(stamp & 0x0FFF);
+    }
+    
     //Decide what data to send and send it
     //left joystick
     if (dataHeader & (JOY << LEFT)) {
         xbeeSerial.print(",");
-        xbeeSerial.print((uint8_t)((joy[LEFT][X] + 1.0) * 127.5));
+        xbeeSerial.print(sentState[0]);
         xbeeSerial.print(",");
-        xbeeSerial.print((uint8_t)((joy[LEFT][Y] + 1.0) * 127.5));
+        xbeeSerial.print(sentState[1]);
     }
     
     //right joysticks
     if (dataHeader & (JOY << RIGHT)) {
         xbeeSerial.print(",");
-        xbeeSerial.print((uint8_t)((joy[RIGHT][X] + 1.0) * 127.5));
+        xbeeSerial.print(sentState[2]);
         xbeeSerial.print(",");
-        xbeeSerial.print((uint8_t)((joy[RIGHT][Y] + 1.0) * 127.5));
+        xbeeSerial.print(sentState[3]);
     }
     
     //left trigger
     if (dataHeader & (TRIGGER << LEFT)) {
         xbeeSerial.print(",");
-        xbeeSerial.print((uint8_t)(triggers[LEFT] * 255));
+        xbeeSerial.print(sentState[4]);
     }
     
     //right trigger
     if (dataHeader & (TRIGGER << RIGHT)) {
         xbeeSerial.print(",");
-        xbeeSerial.print((uint8_t)(triggers[RIGHT] * 255));
+        xbeeSerial.print(sentState[5]);
     }
     
     //left button set
     if (dataHeader & (BUTTONS << LEFT)) {
         xbeeSerial.print(",");
-        printBinary(buttons[LEFT]);
+        printBinary(sentState[6]);
     }
     
     //right button set
     if (dataHeader & (BUTTONS << RIGHT)) {
         xbeeSerial.print(",");
-        printBinary(buttons[RIGHT]);
+        printBinary(sentState[7]);
+    }
+    
+    //extension fields, then the packet CRC
+    if (dataHeader & EXTENDED) {
+        for (int i = 0; i < NUM_EXT_FIELDS; i++) {
+            if (extHeader & (1 << i)) {
+                xbeeSerial.print(",");
+                xbeeSerial.print(extValues[i]);
+            }
+        }
+        xbeeSerial.print(",");
+        xbeeSerial.print(packetCheck(stamp));
     }
     
     xbeeSerial.println("");
@@ -323,4 +674,115 @@ void Controller::send() {
     //reset sending vars
     lastSend = millis();
     dataHeader = 0;
+    extHeader = 0;
 }
+
+
+/**
+* Send a keepalive: the keepalive header, a digest of the last sent values, and a CRC of 
+* the two.
+*/
+void Controller::sendKeepalive() {
+    uint8_t digest = stateDigest();
+    uint8_t check = crc8(crc8(0, KEEPALIVE), digest);
+    
+#ifndef DEBUG_MODE  //transmit normally
+    xbeeSerial.write(KEEPALIVE);
+    xbeeSerial.write(digest);
+    xbeeSerial.write(check);
+#else  //send in human-readable text
+    printBinary(KEEPALIVE);
+    xbeeSerial.print(",");
+    xbeeSerial.print(digest);
+    xbeeSerial.print(",");
+    xbeeSerial.println(check);
+#endif
+
+    lastSend = millis();
+    lastDigest = millis();
+}
+
+/**
+* Get the CRC-8 (polynomial 0x07) of the 8 data bytes as they were last sent, followed by 
+* the bytes of the digital extension fields that have been sent (in field order, not the 
+* edge counts). The receiver does the same over what it has received.
+*
+* @return the digest.
+*/
+uint8_t Controller::stateDigest() {
+    uint8_t crc = 0;
+    
+    for (int i = 0; i < 8; i++) {
+        crc = crc8(crc, sentState[i]);
+    }
+    
+    uint8_t fields = extSent & extDigital & ~EDGE_FIELDS;
+    uint8_t offset = 0;
+    for (int i = 0; i < NUM_EXT_FIELDS; i++) {
+        if (fields & (1 << i)) {
+            for (int j = 0; j < extFields[i].width; j++) {
+                crc = crc8(crc, sentExt[offset + j]);
+            }
+        }
+        offset += extFields[i].width;
+    }
+    
+    return crc;
+}
+
+/**
+* Get the CRC-8 (polynomial 0x07) of an extended packet: the header, bitmap, stamp, data, 
+* and extension fields, in the order they are sent. It goes at the end of the packet so 
+* the receiver can throw out a packet that lost a byte (and would fake button edges).
+*
+* @param stamp - the stamp being sent (if any).
+* @return the CRC.
+*/
+uint8_t Controller::packetCheck(uint16_t stamp) {
+    uint8_t crc = crc8(0, dataHeader);
+    crc = crc8(crc, extHeader);
+    
+    if (dataHeader & STAMP) {
+        crc = crc8(crc, stamp >> 8);
+        crc = crc8(crc, stamp & 0xFF);
+    }
+    
+    for (int i = 0; i < 8; i++) {
+        if (dataHeader & STATE_BITS[i]) {
+            crc = crc8(crc, sentState[i]);
+        }
+    }
+    
+    uint8_t offset = 0;
+    for (int i = 0; i < NUM_EXT_FIELDS; i++) {
+        if (extHeader & (1 << i)) {
+            for (int j = 0; j < extFields[i].width; j++) {
+                crc = crc8(crc, sentExt[offset + j]);
+            }
+        }
+        offset += extFields[i].width;
+    }
+    
+    return crc;
+}
+
+/**
+* Get the joystick value as it is sent. (-1.0 to 1.0 becomes 0 to 255).
+*
+* @param side - Joystick side. (LEFT or RIGHT).
+* @param axis - Axis for the value. (X or Y).
+* @return the byte to send.
+*/
+uint8_t Controller::joyByte(Dir side, Axis axis) {
+    return (uint8_t)((joy[side][axis] + 1.0) * 127.5);
+}
+
+/**
+* Get the trigger value as it is sent. (0.0 to 1.0 becomes 0 to 255).
+*
+* @param side - Trigger side. (LEFT or RIGHT).
+* @return the byte to send.
+*/
+uint8_t Controller::triggerByte(Dir side) {
+    return (uint8_t)(triggers[side] * 255);
+}
\ No newline at end of file
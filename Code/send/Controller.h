@@ -6,6 +6,7 @@
 #define CONTROLLER_H
 
 #include "Arduino.h"
+#include "ControllerFields.h"
 
 enum Dir { LEFT, RIGHT, UP, DOWN };
 enum Axis { X, Y };
@@ -21,6 +22,11 @@ public:
     void setDpad(Dir dir, bool pressed);
     void setBumper(Dir side, bool pressed);
     void setTrigger(Dir side, float value);
+    void setField(ExtField field, float value);
+    void setStamping(bool enabled);
+    void setRefreshInterval(uint16_t interval);
+    void setKeepalive(bool enabled);
+    void setRedundancy(uint8_t repeats);
     
     void update();
   
@@ -29,18 +35,43 @@ private:
     
     void send();
     void fullSend();
+    void sendKeepalive();
+    uint8_t stateDigest();
+    uint8_t packetCheck(uint16_t stamp);
+    uint8_t joyByte(Dir side, Axis axis);
+    uint8_t triggerByte(Dir side);
     
     //controller data
     float joy[2][2];
     float triggers[2];
     uint8_t buttons[2];
+    uint8_t sentState[8] = {0};  //data bytes as last sent (for the digest)
+    
+    int32_t extValues[NUM_EXT_FIELDS];  //extension field values in counts
+    uint8_t sentExt[MAX_EXT_BYTES] = {0};  //extension field bytes as last sent (for the digest)
     
     uint8_t dataHeader = 0;  //header for the packet of send data
+    uint8_t extHeader = 0;   //bitmap of extension fields to send
+    uint8_t extUsed = 0;     //bitmap of extension fields that have been set
+    uint8_t extDigital = 0;  //bitmap of extension fields that send right away
+    uint8_t extSent = 0;     //bitmap of extension fields that have been sent
+    uint16_t edgeCounts[2] = {0, 0};  //2-bit edge count for each button
+    uint8_t edgeRepeats[2] = {0, 0};  //packets left to carry the edge counts
+    uint8_t redundancy = 0;           //extra packets to carry the edge counts
+    uint8_t edgesOff[2] = {0, 0};     //button bytes left to carry the counts-off marker
+    bool stamping = false;   //add the sender time/sequence stamp to each packet
+    uint8_t sequence = 0;    //4-bit packet sequence number for the stamp
+    bool keepalive = true;   //send keepalives instead of full sends when idle
+    bool refreshRequested = false;  //the receiver asked for a full send
+    bool heardReceiver = false;     //the receiver has sent something back
     
     //serial
     HardwareSerial &xbeeSerial;
     uint32_t lastSend = 0;
     uint32_t lastFullSend = 0;
+    uint32_t lastDigest = 0;   //time of the last keepalive or full send
+    uint32_t lastHeard = 0;    //time the receiver last sent something back
+    uint16_t refreshInterval;  //max time between full sends
 };
 
 #endif
@@ -0,0 +1,67 @@
+/*
+ * Registry of the extension fields. This file is shared by the send and receive code
+ * and must be the same in both folders.
+ *
+ * The 8 base fields (joysticks, triggers, buttons) have their own header bits. Anything
+ * else is an extension field. Setting bit 7 of the header means an extension bitmap
+ * byte comes right after the header. Each bit in the bitmap is one of the fields
+ * below, and the data for those fields comes after the base data, in order. The packet
+ * ends with a CRC-8 (polynomial 0x07) of everything before it:
+ * +--------+--------+---------+-----------+------------+-----+
+ * |   0    |   1    |  (2-3)  |    ...    |    ...     | ... |
+ * +--------+--------+---------+-----------+------------+-----+
+ * | header | bitmap | (stamp) | base data | ext fields | crc |
+ * +--------+--------+---------+-----------+------------+-----+
+ *
+ * The receiver throws out an extended packet that doesn't match its CRC, since the
+ * button edge counts in it would replay presses. Multi-byte fields are sent high byte
+ * first. Bit 7 of the bitmap is reserved for a second bitmap byte, so there can be at
+ * most 7 fields here for now.
+ *
+ * The button edge counts are bits 0 and 1 so that if a header is lost, the bitmap looks 
+ * like a joystick header to the receiver (not a button header that would fake presses).
+ *
+ * To add a field, add it to the end of ExtField and extFields (never reorder them), and
+ * make sure MAX_EXT_BYTES still covers the sum of the widths.
+ */
+
+#ifndef CONTROLLER_FIELDS_H
+#define CONTROLLER_FIELDS_H
+
+#include "Arduino.h"
+
+enum ExtField { BUTTON_EDGES_L, BUTTON_EDGES_R, IMU_X, IMU_Y, IMU_Z, BATTERY, EXTRA_BUTTONS, NUM_EXT_FIELDS };
+enum FieldEncoding { FIELD_U8, FIELD_S8, FIELD_U16, FIELD_S16 };
+
+#define MAX_EXT_BYTES 16  //total width of all the extension fields
+
+//check for the button edge counts: the three low nibbles xor'd together (and with this)
+#define EDGE_CHECK 0xA
+
+//the same check made with this instead means the counts have stopped (redundancy was
+//turned off), so the receiver should take button bytes without them again
+#define EDGE_OFF 0x5
+
+//the button edge count fields. The keepalive digest covers the other digital fields (the 
+//edge counts repeat on their own).
+#define EDGE_FIELDS ((1 << BUTTON_EDGES_L) | (1 << BUTTON_EDGES_R))
+
+//how an extension field is sent
+struct FieldInfo {
+    uint8_t width;           //bytes on the wire
+    FieldEncoding encoding;  //how the bytes are read
+    float scale;             //value of one count
+    bool digital;            //send right away (like the buttons) instead of every analog interval
+};
+
+const FieldInfo extFields[NUM_EXT_FIELDS] = {
+    { 2, FIELD_U16, 1.0,   true  },  //BUTTON_EDGES_L: 2-bit edge count per left button, check in the top 4 bits
+    { 2, FIELD_U16, 1.0,   true  },  //BUTTON_EDGES_R
+    { 2, FIELD_S16, 0.001, false },  //IMU_X: acceleration in g
+    { 2, FIELD_S16, 0.001, false },  //IMU_Y
+    { 2, FIELD_S16, 0.001, false },  //IMU_Z
+    { 2, FIELD_U16, 0.001, false },  //BATTERY: voltage in V
+    { 1, FIELD_U8,  1.0,   true  },  //EXTRA_BUTTONS: one bit per button
+};
+
+#endif
@@ -0,0 +1,155 @@
+/* 
+ * Cooperative task scheduler.
+ * 
+ * Tasks are added to a fixed table along with the period they should run at. Each 
+ * call to run() goes through the table and runs any task whose time has come. Tasks 
+ * should do a small amount of work and return. Don't use delay() in a task or every 
+ * other task will be held up.
+ * 
+ * Timing is tracked for each task:
+ *   - runs: number of times the task has run
+ *   - overruns: number of times the task was late by a full period. The missed runs 
+ *     are skipped rather than run back to back.
+ *   - maxRuntime/avgRuntime: time spent in the task in us
+ * 
+ * The longest gap between calls to run() is also tracked. If this is longer than the 
+ * shortest period, something is hogging the loop.
+ */
+
+#include "Scheduler.h"
+
+/**
+ * @brief Add a task to the table. Tasks run in the order they are added.
+ * 
+ * @param task - function to run.
+ * @param period - time between runs in ms.
+ * @return id of the task (used for stats), or -1 if the table is full.
+ */
+int8_t Scheduler::addTask(void (*task)(), uint16_t period) {
+    if (numTasks >= MAX_TASKS) {
+        return -1;
+    }
+    
+    Task &newTask = tasks[numTasks];
+    newTask.task = task;
+    newTask.period = (uint32_t)period * 1000;
+    newTask.nextRun = micros();
+    newTask.runs = 0;
+    newTask.overruns = 0;
+    newTask.maxRuntime = 0;
+    newTask.avgRuntime8 = 0;
+    
+    return numTasks++;
+}
+
+/**
+ * @brief Run any tasks that are due. Call this in loop() as often as possible.
+ */
+void Scheduler::run() {
+    uint32_t now = micros();
+    
+    //track the loop timing
+    if (lastRun != 0 && now - lastRun > maxGap) {
+        maxGap = now - lastRun;
+    }
+    lastRun = now;
+    
+    for (uint8_t i = 0; i < numTasks; i++) {
+        Task &curTask = tasks[i];
+        
+        //skip if not time yet
+        if ((int32_t)(micros() - curTask.nextRun) < 0) {
+            continue;
+        }
+        
+        //run the task and time it
+        uint32_t start = micros();
+        curTask.task();
+        uint32_t runtime = micros() - start;
+        
+        //update the stats
+        curTask.runs++;
+        if (runtime > curTask.maxRuntime) {
+            curTask.maxRuntime = runtime;
+        }
+        curTask.avgRuntime8 += runtime - curTask.avgRuntime8 / 8;
+        
+        //schedule the next run. If we missed a full period, skip ahead instead of catching up.
+        curTask.nextRun += curTask.period;
+        if ((int32_t)(micros() - curTask.nextRun) >= 0) {
+            curTask.overruns++;
+            curTask.nextRun = micros() + curTask.period;
+        }
+    }
+}
+
+/**
+ * @brief Get the timing info for a task.
+ * 
+ * @param task - id of the task (from addTask()).
+ * @return the task stats.
+ */
+TaskStats Scheduler::stats(uint8_t task) {
+    TaskStats taskStats = {0, 0, 0, 0};
+    
+    if (task < numTasks) {
+        taskStats.runs = tasks[task].runs;
+        taskStats.overruns = tasks[task].overruns;
+        taskStats.maxRuntime = tasks[task].maxRuntime;
+        taskStats.avgRuntime = tasks[task].avgRuntime8 / 8;
+    }
+    
+    return taskStats;
+}
+
+/**
+ * @brief Get the longest time between calls to run().
+ * 
+ * @return longest gap in us.
+ */
+uint32_t Scheduler::maxLoopGap() {
+    return maxGap;
+}
+
+/**
+ * @brief Reset the stats for all tasks and the loop timing.
+ */
+void Scheduler::resetStats() {
+    for (uint8_t i = 0; i < numTasks; i++) {
+        tasks[i].runs = 0;
+        tasks[i].overruns = 0;
+        tasks[i].maxRuntime = 0;
+        tasks[i].avgRuntime8 = 0;
+    }
+    
+    maxGap = 0;
+}
+
+/**
+ * @brief Print the timing info for all tasks. Don't print this to the xbee serial!
+ * 
+ * Format:
+ * task:[id],runs:[runs],over:[overruns],max:[us],avg:[us]
+ * loopGap:[us]
+ * 
+ * @param out - stream to print to.
+ */
+void Scheduler::printStats(Stream &out) {
+    for (uint8_t i = 0; i < numTasks; i++) {
+        TaskStats taskStats = stats(i);
+        
+        out.print("task:");
+        out.print(i);
+        out.print(",runs:");
+        out.print(taskStats.runs);
+        out.print(",over:");
+        out.print(taskStats.overruns);
+        out.print(",max:");
+        out.print(taskStats.maxRuntime);
+        out.print(",avg:");
+        out.println(taskStats.avgRuntime);
+    }
+    
+    out.print("loopGap:");
+    out.println(maxGap);
+}
@@ -0,0 +1,49 @@
+/* 
+ * Header for the task scheduler class.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "Arduino.h"
+
+//max number of tasks in the table
+#define MAX_TASKS 8
+
+//timing info for a task
+struct TaskStats {
+    uint32_t runs;        //number of times the task has run
+    uint32_t overruns;    //number of times the task missed its slot
+    uint32_t maxRuntime;  //longest run in us
+    uint32_t avgRuntime;  //average run in us
+};
+
+class Scheduler {
+public:
+    int8_t addTask(void (*task)(), uint16_t period);
+    void run();
+    
+    TaskStats stats(uint8_t task);
+    uint32_t maxLoopGap();
+    void resetStats();
+    void printStats(Stream &out);
+  
+private:
+    struct Task {
+        void (*task)();        //function to call
+        uint32_t period;       //time between runs in us
+        uint32_t nextRun;      //time of the next run in us
+        uint32_t runs;
+        uint32_t overruns;
+        uint32_t maxRuntime;
+        uint32_t avgRuntime8;  //average runtime times 8
+    };
+    
+    Task tasks[MAX_TASKS];
+    uint8_t numTasks = 0;
+    
+    uint32_t lastRun = 0;  //time of the last call to run()
+    uint32_t maxGap = 0;   //longest time between calls to run()
+};
+
+#endif
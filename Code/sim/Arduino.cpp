@@ -0,0 +1,120 @@
+/* 
+ * Host stand-in for the Arduino core. See Arduino.h.
+ */
+
+#include "Arduino.h"
+
+thread_local uint64_t simTime = 0;
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+HardwareSerial Serial2;
+HardwareSerial Serial3;
+
+/**
+ * @brief Write a buffer one byte at a time.
+ */
+size_t Stream::write(const uint8_t *buf, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        write(buf[i]);
+    }
+    
+    return len;
+}
+
+/**
+ * @brief Nothing to set up. The link decides the timing.
+ */
+void HardwareSerial::begin(unsigned long) { }
+
+/**
+ * @brief Get the number of bytes in the receive buffer. If it is empty, time moves 
+ * forward by spinTime so busy waits on the port still time out.
+ */
+int HardwareSerial::available() {
+    moveArrived();
+    
+    if (rxBuffer.empty()) {
+        simTime += spinTime;
+        moveArrived();
+    }
+    
+    return rxBuffer.size();
+}
+
+/**
+ * @brief Read a byte from the receive buffer, and track how long it waited there.
+ * 
+ * @return the byte, or -1 if the buffer is empty.
+ */
+int HardwareSerial::read() {
+    moveArrived();
+    
+    if (rxBuffer.empty()) {
+        return -1;
+    }
+    
+    uint64_t wait = simTime - rxBuffer.front().first;
+    bytesRead++;
+    waitTotal += wait;
+    if (wait > waitMax) {
+        waitMax = wait;
+    }
+    
+    int val = rxBuffer.front().second;
+    rxBuffer.pop_front();
+    return val;
+}
+
+/**
+ * @brief Look at the next byte without removing it.
+ * 
+ * @return the byte, or -1 if the buffer is empty.
+ */
+int HardwareSerial::peek() {
+    moveArrived();
+    
+    return rxBuffer.empty() ? -1 : rxBuffer.front().second;
+}
+
+/**
+ * @brief Write a byte. It waits in sent until the link picks it up.
+ */
+size_t HardwareSerial::write(uint8_t val) {
+    sent.push_back(val);
+    return 1;
+}
+
+/**
+ * @brief Schedule a byte to arrive. Bytes must be delivered in order of arrival.
+ * 
+ * @param val - the byte.
+ * @param arrival - time the byte is done arriving (us).
+ */
+void HardwareSerial::deliver(uint8_t val, uint64_t arrival) {
+    pending.push_back(std::make_pair(arrival, val));
+}
+
+/**
+ * @brief Drop everything in flight and in the buffers.
+ */
+void HardwareSerial::clear() {
+    sent.clear();
+    pending.clear();
+    rxBuffer.clear();
+}
+
+/**
+ * @brief Move bytes that have arrived into the receive buffer.
+ */
+void HardwareSerial::moveArrived() {
+    while (!pending.empty() && pending.front().first <= simTime) {
+        if (rxBuffer.size() < rxBufferSize) {
+            rxBuffer.push_back(pending.front());
+        } else {
+            overflows++;
+        }
+        
+        pending.pop_front();
+    }
+}
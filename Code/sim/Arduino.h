@@ -0,0 +1,118 @@
+/* 
+ * Host stand-in for the parts of the Arduino core used by the controller classes.
+ * 
+ * Time is virtual. simTime (in us) only moves when the simulation moves it, or when 
+ * code polls an empty serial port (each empty poll costs the port's spinTime). This lets the 
+ * receiver's blocking reads time out the same way they would on the board.
+ * Each thread has its own clock, so separate simulations can run on separate threads.
+ * 
+ * Include any standard headers before this one. Like the real core, min() and max() 
+ * are macros.
+ */
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <deque>
+#include <utility>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+//default time spent on each poll of an empty serial port (us)
+#define SPIN_TIME 10
+
+//size of the serial receive buffer (same as the Arduino default)
+#define SERIAL_RX_BUFFER_SIZE 64
+
+#define abs(x) ((x)>0?(x):-(x))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#ifndef min
+#define min(a,b) ((a)<(b)?(a):(b))
+#endif
+#ifndef max
+#define max(a,b) ((a)>(b)?(a):(b))
+#endif
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define INPUT  0
+#define OUTPUT 1
+#define LOW    0
+#define HIGH   1
+
+//virtual time in us (one per thread)
+extern thread_local uint64_t simTime;
+
+inline unsigned long millis() { return (uint32_t)(simTime / 1000); }
+inline unsigned long micros() { return (uint32_t)simTime; }
+inline void delay(unsigned long ms) { simTime += (uint64_t)ms * 1000; }
+inline void delayMicroseconds(unsigned int us) { simTime += us; }
+
+inline int analogRead(uint8_t) { return 512; }
+inline int digitalRead(uint8_t) { return LOW; }
+inline void digitalWrite(uint8_t, uint8_t) { }
+inline void pinMode(uint8_t, uint8_t) { }
+
+/**
+ * Output stream. Printing goes nowhere.
+ */
+class Stream {
+public:
+    virtual ~Stream() { }
+    virtual size_t write(uint8_t val) = 0;
+    size_t write(const uint8_t *buf, size_t len);
+    
+    template <typename T> size_t print(T) { return 0; }
+    template <typename T> size_t print(T, int) { return 0; }
+    template <typename T> size_t println(T) { return 0; }
+    size_t println() { return 0; }
+};
+
+/**
+ * Serial port. Bytes written are kept in sent for the link to pick up. Bytes from the 
+ * link are scheduled with deliver() and show up once their arrival time has passed. 
+ * If the receive buffer is full when a byte arrives, the byte is lost (like the board).
+ */
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long baud);
+    
+    int available();
+    int read();
+    int peek();
+    using Stream::write;
+    size_t write(uint8_t val);
+    
+    //host side
+    void deliver(uint8_t val, uint64_t arrival);
+    void clear();
+    
+    std::deque<uint8_t> sent;   //bytes written, waiting for the link
+    uint32_t overflows = 0;     //bytes lost to a full receive buffer
+    size_t rxBufferSize = SERIAL_RX_BUFFER_SIZE;
+    uint32_t spinTime = SPIN_TIME;  //time each poll of an empty receive buffer takes (us)
+    uint64_t bytesRead = 0;     //bytes taken from the receive buffer
+    uint64_t waitTotal = 0;     //total time the bytes read sat in the receive buffer (us)
+    uint64_t waitMax = 0;       //longest time a byte read sat in the receive buffer (us)
+  
+private:
+    void moveArrived();
+    
+    std::deque<std::pair<uint64_t, uint8_t> > pending;  //bytes on the way (arrival, value)
+    std::deque<std::pair<uint64_t, uint8_t> > rxBuffer;  //bytes arrived (arrival, value)
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+extern HardwareSerial Serial3;
+
+#endif
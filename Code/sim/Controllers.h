@@ -0,0 +1,27 @@
+/* 
+ * Pulls the send and receive controller classes into one program.
+ * 
+ * Both classes are called Controller and share header guards, so each one is built 
+ * into its own namespace: tx::Controller (send) and rx::Controller (receive). Only 
+ * include this from one file in a program, since it includes the .cpp files.
+ */
+
+#ifndef CONTROLLERS_H
+#define CONTROLLERS_H
+
+#include "Arduino.h"
+
+namespace tx {
+#include "../send/Controller.h"
+#include "../send/Controller.cpp"
+}
+
+#undef CONTROLLER_H
+#undef CONTROLLER_FIELDS_H
+
+namespace rx {
+#include "../receive/Controller.h"
+#include "../receive/Controller.cpp"
+}
+
+#endif
@@ -0,0 +1,136 @@
+/* 
+ * Model of a lossy serial radio link between two HardwareSerial stand-ins.
+ * 
+ * Bytes written to the from port are sent down the link one at a time, taking one 
+ * byte time each at the set baud rate. Each byte can be hit by these faults:
+ *   - drop: the byte is lost
+ *   - flip: one random bit is flipped
+ *   - burst: the byte and the next (burstLength - 1) bytes are lost
+ *   - duplicate: the byte arrives twice
+ *   - stall: the link stops for stallTime before the byte. This splits packets up.
+ * 
+ * The random numbers come from a seeded xorshift, so a run with the same seed and 
+ * settings is always the same.
+ */
+
+#include "LinkModel.h"
+
+#define DEFAULT_BAUD 115200
+
+/**
+ * @brief Constructor for the class.
+ * 
+ * @param from - port the sender writes to.
+ * @param to - port the receiver reads from.
+ * @param seed - seed for the faults.
+ */
+LinkModel::LinkModel(HardwareSerial &from, HardwareSerial &to, uint32_t seed) 
+    : from(from), to(to), faults(), linkStats(), seed(seed ? seed : 1) {
+    setBaud(DEFAULT_BAUD);
+}
+
+/**
+ * @brief Set the faults for the link. All zero is a perfect link.
+ */
+void LinkModel::setFaults(const LinkFaults &faults) {
+    this->faults = faults;
+}
+
+/**
+ * @brief Set the baud rate. 10 bits per byte (start + 8 data + stop).
+ */
+void LinkModel::setBaud(uint32_t baud) {
+    byteTime = 10000000 / baud;
+}
+
+/**
+ * @brief Set a fixed delay for every byte, on top of the byte time.
+ * 
+ * @param latency - delay in us.
+ */
+void LinkModel::setLatency(uint32_t latency) {
+    this->latency = latency;
+}
+
+/**
+ * @brief Send everything the sender has written down the link. Call this after 
+ * each sender update.
+ */
+void LinkModel::transfer() {
+    while (!from.sent.empty()) {
+        uint8_t val = from.sent.front();
+        from.sent.pop_front();
+        linkStats.bytes++;
+        
+        //line can't start before now
+        if (lineFree < simTime) {
+            lineFree = simTime;
+        }
+        
+        //stall before the byte
+        if (random() < faults.stallRate) {
+            lineFree += faults.stallTime;
+            linkStats.stalls++;
+        }
+        
+        //lost bytes still take up the line
+        if (burstLeft > 0) {
+            burstLeft--;
+            linkStats.dropped++;
+            lineFree += byteTime;
+            continue;
+        }
+        if (random() < faults.burstRate) {
+            burstLeft = faults.burstLength > 0 ? faults.burstLength - 1 : 0;
+            linkStats.bursts++;
+            linkStats.dropped++;
+            lineFree += byteTime;
+            continue;
+        }
+        if (random() < faults.dropRate) {
+            linkStats.dropped++;
+            lineFree += byteTime;
+            continue;
+        }
+        
+        //flip a bit
+        if (random() < faults.flipRate) {
+            val ^= 1 << (int)(random() * 8);
+            linkStats.flipped++;
+        }
+        
+        send(val);
+        
+        if (random() < faults.dupRate) {
+            send(val);
+            linkStats.duplicated++;
+        }
+    }
+}
+
+/**
+ * @brief Get the counts of what the link has done.
+ */
+LinkStats LinkModel::stats() {
+    return linkStats;
+}
+
+/**
+ * @brief Get a random number from 0.0 up to (not including) 1.0.
+ */
+float LinkModel::random() {
+    //xorshift32
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    
+    return (seed >> 8) / 16777216.0f;
+}
+
+/**
+ * @brief Put a byte on the line.
+ */
+void LinkModel::send(uint8_t val) {
+    lineFree += byteTime;
+    to.deliver(val, lineFree + latency);
+}
@@ -0,0 +1,58 @@
+/* 
+ * Header for the lossy link model.
+ */
+
+#ifndef LINK_MODEL_H
+#define LINK_MODEL_H
+
+#include "Arduino.h"
+
+//fault settings for the link. Rates are the chance per byte (0.0 to 1.0).
+struct LinkFaults {
+    float dropRate;        //byte is lost
+    float flipRate;        //one bit of the byte is flipped
+    float burstRate;       //a burst of bytes is lost
+    uint16_t burstLength;  //number of bytes lost in a burst
+    float dupRate;         //byte is sent twice
+    float stallRate;       //the link stalls before the byte
+    uint32_t stallTime;    //length of a stall (us)
+};
+
+//counts of what the link did
+struct LinkStats {
+    uint32_t bytes;      //bytes sent into the link
+    uint32_t dropped;    //bytes lost (including bursts)
+    uint32_t flipped;
+    uint32_t bursts;
+    uint32_t duplicated;
+    uint32_t stalls;
+};
+
+class LinkModel {
+public:
+    LinkModel(HardwareSerial &from, HardwareSerial &to, uint32_t seed = 1);
+    
+    void setFaults(const LinkFaults &faults);
+    void setBaud(uint32_t baud);
+    void setLatency(uint32_t latency);
+    
+    void transfer();
+    LinkStats stats();
+  
+private:
+    float random();
+    void send(uint8_t val);
+    
+    HardwareSerial &from;
+    HardwareSerial &to;
+    LinkFaults faults;
+    LinkStats linkStats;
+    
+    uint32_t seed;            //random state
+    uint32_t byteTime;        //time to send one byte (us)
+    uint32_t latency = 0;     //fixed delay added to every byte (us)
+    uint64_t lineFree = 0;    //time the line is done with the last byte
+    uint16_t burstLeft = 0;   //bytes left in the current burst
+};
+
+#endif
@@ -0,0 +1,161 @@
+/*
+ * Check of drain mode: how often a slowly polled receiver is behind the sender.
+ *
+ * Each scenario runs a sender with moving sticks through a clean link to two receivers.
+ * The reference receiver is polled every ms. The receiver under test has drain mode on
+ * and is only polled every poll interval. Right after each of its polls, it should have
+ * read every packet that was in its buffer, so its values should match the reference.
+ * Its buffer and drain limit are made big enough that only the parser can fall behind.
+ * Reported per scenario:
+ *   - polls: polls of the receiver under test
+ *   - stale: polls where its values didn't match the reference
+ *
+ * Usage: drainbench [seconds per scenario] [poll interval ms]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Controllers.h"
+#include "LinkModel.h"
+
+#define RUN_TIME 20          //default seconds per scenario
+#define POLL_INTERVAL 200    //default time between polls of the receiver under test (ms)
+#define TICK 1000            //time between sender updates and reference polls (us)
+#define BUFFER_SIZE 1024     //receive buffer and drain limit of the receiver under test
+#define NUM_VALUES 9         //4 joystick axes, 2 triggers, 3 IMU axes
+
+struct Scenario {
+    const char *name;
+    bool imu;          //send the IMU fields (extended packets)
+    uint8_t repeats;   //button edge redundancy (extended packets after a button change)
+};
+
+const Scenario scenarios[] = {
+    { "base",      false, 0 },
+    { "imu",       true,  0 },
+    { "edges k=1", false, 1 },
+};
+
+/**
+ * Simple xorshift so the inputs are the same on every machine.
+ */
+uint32_t inputSeed;
+float inputRandom() {
+    inputSeed ^= inputSeed << 13;
+    inputSeed ^= inputSeed >> 17;
+    inputSeed ^= inputSeed << 5;
+    return (inputSeed >> 8) / 16777216.0f;
+}
+
+/**
+ * Read the values to compare from a receiver.
+ */
+void readValues(rx::Controller &receiver, float values[]) {
+    values[0] = receiver.joystick(rx::LEFT, rx::X);
+    values[1] = receiver.joystick(rx::LEFT, rx::Y);
+    values[2] = receiver.joystick(rx::RIGHT, rx::X);
+    values[3] = receiver.joystick(rx::RIGHT, rx::Y);
+    values[4] = receiver.trigger(rx::LEFT);
+    values[5] = receiver.trigger(rx::RIGHT);
+    values[6] = receiver.field(rx::IMU_X);
+    values[7] = receiver.field(rx::IMU_Y);
+    values[8] = receiver.field(rx::IMU_Z);
+}
+
+/**
+ * Run one scenario and print a line of results.
+ */
+void runScenario(const Scenario &scenario, uint32_t seconds, uint32_t pollInterval) {
+    HardwareSerial senderPort, refPort, testPort;
+    tx::Controller sender(senderPort);
+    rx::Controller reference(refPort);
+    rx::Controller test(testPort);
+
+    //both links are fed the same bytes
+    HardwareSerial refSent, testSent;
+    LinkModel refLink(refSent, refPort);
+    LinkModel testLink(testSent, testPort);
+
+    simTime = 0;
+    inputSeed = 1;
+    sender.init();
+    sender.setRedundancy(scenario.repeats);
+    reference.init();
+    test.init();
+    testPort.rxBufferSize = BUFFER_SIZE;
+    test.setDrain(true, BUFFER_SIZE);
+
+    float refValues[NUM_VALUES], testValues[NUM_VALUES];
+    uint32_t polls = 0, stale = 0;
+    uint32_t nextPoll = pollInterval;
+
+    uint64_t nextTick = 0;
+    while (simTime < (uint64_t)seconds * 1000000) {
+        //the receivers may have used up time waiting on a packet
+        if (simTime < nextTick) {
+            simTime = nextTick;
+        }
+        nextTick = simTime + TICK;
+
+        //sender
+        float t = millis() / 1000.0;
+        sender.setJoystick(tx::LEFT, tx::X, sin(t * 1.3));
+        sender.setJoystick(tx::LEFT, tx::Y, cos(t * 0.7));
+        sender.setTrigger(tx::LEFT, (sin(t * 0.4) + 1.0) / 2.0);
+        if (scenario.imu) {
+            sender.setField(tx::IMU_X, (inputRandom() - 0.5) * 0.04);
+            sender.setField(tx::IMU_Y, (inputRandom() - 0.5) * 0.04);
+            sender.setField(tx::IMU_Z, 1 + (inputRandom() - 0.5) * 0.04);
+        }
+        if (scenario.repeats && inputRandom() < 0.01) {
+            sender.setBumper(tx::LEFT, inputRandom() < 0.5);
+        }
+        sender.update();
+
+        while (!senderPort.sent.empty()) {
+            refSent.write(senderPort.sent.front());
+            testSent.write(senderPort.sent.front());
+            senderPort.sent.pop_front();
+        }
+        refPort.sent.clear();
+        testPort.sent.clear();
+        refLink.transfer();
+        testLink.transfer();
+
+        //receivers
+        reference.receiveData();
+        if (millis() >= nextPoll) {
+            test.receiveData();
+            nextPoll += pollInterval;
+
+            readValues(reference, refValues);
+            readValues(test, testValues);
+            bool match = true;
+            for (int i = 0; i < NUM_VALUES; i++) {
+                match = match && testValues[i] == refValues[i];
+            }
+
+            polls++;
+            if (!match) {
+                stale++;
+            }
+        }
+    }
+
+    printf("%-10s %6u %6u %7.2f%%\n", scenario.name, polls, stale, polls ? 100.0 * stale / polls : 0.0);
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t seconds = argc > 1 ? atoi(argv[1]) : RUN_TIME;
+    uint32_t pollInterval = argc > 2 ? atoi(argv[2]) : POLL_INTERVAL;
+
+    printf("%u s per scenario, test receiver polled every %u ms\n", seconds, pollInterval);
+    printf("%-10s %6s %6s %8s\n", "scenario", "polls", "stale", "stale");
+
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        runScenario(scenarios[i], seconds, pollInterval);
+    }
+
+    return 0;
+}
@@ -0,0 +1,185 @@
+/*
+ * Check of the failsafe: how long the receiver takes to get the controller's values back
+ * after the link comes back from a cut.
+ *
+ * Each scenario holds the left stick at full Y and the left trigger at 0.6 on a sender,
+ * and sends it through a clean link to a reference receiver and through a link that is
+ * cut every so often to the receiver under test, which has the failsafe on. Refresh
+ * requests go back to the sender on the same cut link (when on). During a cut the
+ * receiver under test should go LOST and zero its values. After the link comes back,
+ * its values should match the reference again soon, not only at the next full send.
+ * Reported per scenario:
+ *   - cuts: link cuts made
+ *   - zeroed: cuts where the receiver under test went LOST with its values at zero
+ *   - recover: time after the link came back until its values matched the reference
+ *     (average and worst, ms)
+ *   - stuck: cuts it didn't recover from before the next cut
+ *
+ * Usage: failsafebench [seconds per scenario]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Controllers.h"
+#include "LinkModel.h"
+
+#define RUN_TIME 60          //default seconds per scenario
+#define TICK 1000            //time between sender updates and receiver polls (us)
+#define CUT_START 2000       //time of the first cut (ms)
+#define CUT_TIME 2000        //length of each cut (ms)
+#define CUT_EVERY 7300       //time from one cut to the next (ms). Not a multiple of the full send interval.
+#define NUM_VALUES 6         //4 joystick axes, 2 triggers
+
+struct Scenario {
+    const char *name;
+    bool moving;       //right stick keeps moving, so there are no keepalives
+    bool requests;     //receiver under test sends refresh requests
+};
+
+const Scenario scenarios[] = {
+    { "still",            false, false },
+    { "still requests",   false, true  },
+    { "moving",           true,  false },
+    { "moving requests",  true,  true  },
+};
+
+/**
+ * Read the values to compare from a receiver.
+ */
+void readValues(rx::Controller &receiver, float values[]) {
+    values[0] = receiver.joystick(rx::LEFT, rx::X);
+    values[1] = receiver.joystick(rx::LEFT, rx::Y);
+    values[2] = receiver.joystick(rx::RIGHT, rx::X);
+    values[3] = receiver.joystick(rx::RIGHT, rx::Y);
+    values[4] = receiver.trigger(rx::LEFT);
+    values[5] = receiver.trigger(rx::RIGHT);
+}
+
+/**
+ * Run one scenario and print a line of results.
+ */
+void runScenario(const Scenario &scenario, uint32_t seconds) {
+    HardwareSerial senderPort, refPort, testPort;
+    tx::Controller sender(senderPort);
+    rx::Controller reference(refPort);
+    rx::Controller test(testPort);
+
+    //both links are fed the same bytes. Only the one to the receiver under test is cut.
+    HardwareSerial refSent, testSent;
+    LinkModel refLink(refSent, refPort);
+    LinkModel testLink(testSent, testPort);
+    LinkModel backLink(testPort, senderPort);
+    const LinkFaults clean = { 0, 0, 0, 0, 0, 0, 0 };
+    const LinkFaults cut = { 1, 0, 0, 0, 0, 0, 0 };
+
+    simTime = 0;
+    sender.init();
+    reference.init();
+    test.init();
+    test.setFailsafe(true);
+    test.setRefreshRequests(scenario.requests);
+
+    float refValues[NUM_VALUES], testValues[NUM_VALUES];
+    uint32_t cuts = 0, zeroed = 0, recovered = 0, stuck = 0;
+    uint32_t recoverTotal = 0, recoverMax = 0;
+    uint32_t nextCut = CUT_START;
+    uint32_t restored = 0;      //time the link came back (ms)
+    bool cutting = false;
+    bool waiting = false;       //link is back but the values don't match yet
+
+    uint64_t nextTick = 0;
+    while (simTime < (uint64_t)seconds * 1000000) {
+        //the receivers may have used up time waiting on a packet
+        if (simTime < nextTick) {
+            simTime = nextTick;
+        }
+        nextTick = simTime + TICK;
+
+        //cut the link or bring it back
+        if (!cutting && millis() >= nextCut) {
+            if (waiting) {
+                stuck++;
+                waiting = false;
+            }
+            testLink.setFaults(cut);
+            backLink.setFaults(cut);
+            cutting = true;
+            cuts++;
+        } else if (cutting && millis() >= nextCut + CUT_TIME) {
+            //the receiver under test should have given up on the link by now
+            readValues(test, testValues);
+            bool zero = test.connectionState() == rx::LOST;
+            for (int i = 0; i < NUM_VALUES; i++) {
+                zero = zero && testValues[i] == 0.0;
+            }
+            if (zero) {
+                zeroed++;
+            }
+
+            testLink.setFaults(clean);
+            backLink.setFaults(clean);
+            cutting = false;
+            waiting = true;
+            restored = millis();
+            nextCut += CUT_EVERY;
+        }
+
+        //sender
+        sender.setJoystick(tx::LEFT, tx::Y, 1.0);
+        sender.setTrigger(tx::LEFT, 0.6);
+        if (scenario.moving) {
+            sender.setJoystick(tx::RIGHT, tx::X, sin(millis() / 1000.0 * 1.3));
+        }
+        sender.update();
+
+        while (!senderPort.sent.empty()) {
+            refSent.write(senderPort.sent.front());
+            testSent.write(senderPort.sent.front());
+            senderPort.sent.pop_front();
+        }
+        refPort.sent.clear();
+        refLink.transfer();
+        testLink.transfer();
+        backLink.transfer();
+
+        //receivers
+        reference.receiveData();
+        test.receiveData();
+
+        if (waiting) {
+            readValues(reference, refValues);
+            readValues(test, testValues);
+            bool match = test.connectionState() == rx::LIVE;
+            for (int i = 0; i < NUM_VALUES; i++) {
+                match = match && testValues[i] == refValues[i];
+            }
+
+            if (match) {
+                uint32_t recoverTime = millis() - restored;
+                recoverTotal += recoverTime;
+                if (recoverTime > recoverMax) {
+                    recoverMax = recoverTime;
+                }
+                recovered++;
+                waiting = false;
+            }
+        }
+    }
+
+    printf("%-16s %5u %6u %8.0f %8u %5u\n", scenario.name, cuts, zeroed,
+           recovered ? (double)recoverTotal / recovered : 0.0, recoverMax, stuck);
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t seconds = argc > 1 ? atoi(argv[1]) : RUN_TIME;
+
+    printf("%u s per scenario, %u ms cut every %u ms\n", seconds, CUT_TIME, CUT_EVERY);
+    printf("%-16s %5s %6s %8s %8s %5s\n", "scenario", "cuts", "zeroed", "avg ms", "max ms", "stuck");
+
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        runScenario(scenarios[i], seconds);
+    }
+
+    return 0;
+}
@@ -0,0 +1,275 @@
+/* 
+ * Benchmark for how the receiver handles a lossy link.
+ * 
+ * Each scenario runs a sender with moving sticks and random button presses for a set 
+ * amount of (virtual) time. The sender's bytes go down two links: a perfect one to a 
+ * reference receiver, and a faulty one to the receiver under test. Both links have 
+ * the same timing, so the two receivers only disagree because of the faults.
+ * 
+ * Refresh requests from the receiver under test go back to the sender on a clean link.
+ * 
+ * Every poll, the values of the two receivers are compared. Reported per scenario:
+ *   - diverge: number of times the receivers started to disagree
+ *   - resync ms: time until they agree again (avg / 95th percentile / max)
+ *   - resync pkts: packets sent by the sender until they agree again (avg / max)
+ *   - wrong: values taken by the receiver under test that the sender never had 
+ *     (not the current value or any value in the last WRONG_WINDOW ms), out of all 
+ *     the value changes it took.
+ * 
+ * Usage: linkbench [seconds per scenario] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+
+#include "Controllers.h"
+#include "LinkModel.h"
+
+#define RUN_TIME 60          //default seconds per scenario
+#define TICK 1000            //time between sender updates and receiver polls (us)
+#define WRONG_WINDOW 1000    //how far back a value still counts as a real value (ms)
+#define NUM_FIELDS 8         //4 joystick axes, 2 triggers, 2 button sets
+
+struct Scenario {
+    const char *name;
+    LinkFaults faults;
+};
+
+//faults: drop, flip, burst, burst length, dup, stall, stall time (us)
+const Scenario scenarios[] = {
+    { "clean",     { 0,     0,     0,     0,  0,     0,     0     } },
+    { "drop 1%",   { 0.01,  0,     0,     0,  0,     0,     0     } },
+    { "drop 5%",   { 0.05,  0,     0,     0,  0,     0,     0     } },
+    { "flip 1%",   { 0,     0.01,  0,     0,  0,     0,     0     } },
+    { "burst 20",  { 0,     0,     0.002, 20, 0,     0,     0     } },
+    { "dup 1%",    { 0,     0,     0,     0,  0.01,  0,     0     } },
+    { "stall 8ms", { 0,     0,     0,     0,  0,     0.01,  8000  } },
+    { "mixed",     { 0.005, 0.005, 0.001, 10, 0.005, 0.005, 8000  } },
+};
+
+/**
+ * Read all the values from a receiver. Buttons are packed the same as on the wire.
+ */
+void readValues(rx::Controller &controller, float values[]) {
+    values[0] = controller.joystick(rx::LEFT, rx::X);
+    values[1] = controller.joystick(rx::LEFT, rx::Y);
+    values[2] = controller.joystick(rx::RIGHT, rx::X);
+    values[3] = controller.joystick(rx::RIGHT, rx::Y);
+    values[4] = controller.trigger(rx::LEFT);
+    values[5] = controller.trigger(rx::RIGHT);
+    
+    uint8_t left = 0;
+    uint8_t right = 0;
+    for (int dir = rx::LEFT; dir <= rx::DOWN; dir++) {
+        left |= controller.dpad((rx::Dir)dir) << dir;
+        right |= controller.button((rx::Dir)dir) << dir;
+    }
+    left |= controller.joyButton(rx::LEFT) << 4 | controller.bumper(rx::LEFT) << 5;
+    right |= controller.joyButton(rx::RIGHT) << 4 | controller.bumper(rx::RIGHT) << 5;
+    values[6] = left;
+    values[7] = right;
+}
+
+/**
+ * Recent values of a field on the reference receiver.
+ */
+struct FieldHistory {
+    std::deque<std::pair<uint32_t, float> > values;  //(time, value)
+    
+    void add(uint32_t time, float value) {
+        values.push_back(std::make_pair(time, value));
+        while (values.size() > 1 && time - values[1].first > WRONG_WINDOW) {
+            values.pop_front();
+        }
+    }
+    
+    bool contains(float value) {
+        for (size_t i = 0; i < values.size(); i++) {
+            if (values[i].second == value) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/**
+ * Simple xorshift so the inputs are the same on every machine.
+ */
+uint32_t inputSeed;
+float inputRandom() {
+    inputSeed ^= inputSeed << 13;
+    inputSeed ^= inputSeed >> 17;
+    inputSeed ^= inputSeed << 5;
+    return (inputSeed >> 8) / 16777216.0f;
+}
+
+/**
+ * Move the sender's inputs like a person would. Sticks and triggers move smoothly and 
+ * buttons get tapped now and then.
+ */
+void moveInputs(tx::Controller &sender, uint32_t time, bool pressed[]) {
+    float t = time / 1000.0;
+    sender.setJoystick(tx::LEFT, tx::X, sin(t * 1.3));
+    sender.setJoystick(tx::LEFT, tx::Y, cos(t * 0.7));
+    sender.setJoystick(tx::RIGHT, tx::X, sin(t * 2.9) * 0.5);
+    sender.setJoystick(tx::RIGHT, tx::Y, 0.0);
+    sender.setTrigger(tx::LEFT, (sin(t * 0.4) + 1.0) / 2.0);
+    sender.setTrigger(tx::RIGHT, 0.0);
+    
+    //toggle a random button a few times a second
+    if (inputRandom() < 0.004) {
+        int button = inputRandom() * 12;
+        pressed[button] = !pressed[button];
+    }
+    for (int dir = tx::LEFT; dir <= tx::DOWN; dir++) {
+        sender.setDpad((tx::Dir)dir, pressed[dir]);
+        sender.setButton((tx::Dir)dir, pressed[4 + dir]);
+    }
+    sender.setJoyButton(tx::LEFT, pressed[8]);
+    sender.setJoyButton(tx::RIGHT, pressed[9]);
+    sender.setBumper(tx::LEFT, pressed[10]);
+    sender.setBumper(tx::RIGHT, pressed[11]);
+}
+
+/**
+ * Run one scenario and print a line of results.
+ */
+void runScenario(const Scenario &scenario, uint32_t seconds, uint32_t seed) {
+    HardwareSerial senderPort, refPort, testPort;
+    tx::Controller sender(senderPort);
+    rx::Controller reference(refPort);
+    rx::Controller test(testPort);
+    
+    //both links are fed the same bytes
+    HardwareSerial refSent, testSent;
+    LinkModel refLink(refSent, refPort, seed);
+    LinkModel testLink(testSent, testPort, seed);
+    testLink.setFaults(scenario.faults);
+    
+    //refresh requests go back to the sender (the reference receiver's are ignored)
+    LinkModel backLink(testPort, senderPort, seed);
+    
+    simTime = 0;
+    inputSeed = seed;
+    sender.init();
+    reference.init();
+    test.init();
+    test.setRefreshRequests(true);
+    
+    bool pressed[12] = { false };
+    float refValues[NUM_FIELDS], testValues[NUM_FIELDS], lastTestValues[NUM_FIELDS];
+    FieldHistory history[NUM_FIELDS];
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        lastTestValues[i] = 0.0;
+    }
+    
+    uint32_t packets = 0;
+    uint32_t accepted = 0;
+    uint32_t wrong = 0;
+    bool diverged = false;
+    uint64_t divergeStart = 0;
+    uint32_t divergePackets = 0;
+    std::vector<uint32_t> resyncTimes;
+    std::vector<uint32_t> resyncPackets;
+    
+    uint64_t nextTick = 0;
+    while (simTime < (uint64_t)seconds * 1000000) {
+        //the receivers may have used up time waiting on a packet
+        if (simTime < nextTick) {
+            simTime = nextTick;
+        }
+        nextTick = simTime + TICK;
+        
+        //sender
+        moveInputs(sender, millis(), pressed);
+        sender.update();
+        if (!senderPort.sent.empty()) {
+            packets++;
+        }
+        while (!senderPort.sent.empty()) {
+            refSent.write(senderPort.sent.front());
+            testSent.write(senderPort.sent.front());
+            senderPort.sent.pop_front();
+        }
+        refPort.sent.clear();
+        refLink.transfer();
+        testLink.transfer();
+        backLink.transfer();
+        
+        //receivers
+        reference.receiveData();
+        test.receiveData();
+        readValues(reference, refValues);
+        readValues(test, testValues);
+        
+        //check for wrong values
+        bool match = true;
+        for (int i = 0; i < NUM_FIELDS; i++) {
+            if (history[i].values.empty() || history[i].values.back().second != refValues[i]) {
+                history[i].add(millis(), refValues[i]);
+            }
+            
+            if (testValues[i] != lastTestValues[i]) {
+                accepted++;
+                if (!history[i].contains(testValues[i])) {
+                    wrong++;
+                }
+                lastTestValues[i] = testValues[i];
+            }
+            
+            match = match && testValues[i] == refValues[i];
+        }
+        
+        //track the time out of sync
+        if (!match && !diverged) {
+            diverged = true;
+            divergeStart = simTime;
+            divergePackets = packets;
+        } else if (match && diverged) {
+            diverged = false;
+            resyncTimes.push_back((simTime - divergeStart) / 1000);
+            resyncPackets.push_back(packets - divergePackets);
+        }
+    }
+    
+    //summarize
+    uint32_t avgTime = 0, p95Time = 0, maxTime = 0;
+    uint32_t avgPackets = 0, maxPackets = 0;
+    if (!resyncTimes.empty()) {
+        uint64_t totalTime = 0, totalPackets = 0;
+        for (size_t i = 0; i < resyncTimes.size(); i++) {
+            totalTime += resyncTimes[i];
+            totalPackets += resyncPackets[i];
+            maxPackets = max(maxPackets, resyncPackets[i]);
+        }
+        avgTime = totalTime / resyncTimes.size();
+        avgPackets = totalPackets / resyncTimes.size();
+        
+        std::sort(resyncTimes.begin(), resyncTimes.end());
+        p95Time = resyncTimes[resyncTimes.size() * 95 / 100];
+        maxTime = resyncTimes.back();
+    }
+    
+    printf("%-10s %8u %8u %7u/%5u/%5u %6u/%5u %7u/%-8u %6.3f%%\n", 
+           scenario.name, packets, (unsigned)resyncTimes.size(), 
+           avgTime, p95Time, maxTime, avgPackets, maxPackets, 
+           wrong, accepted, accepted ? 100.0 * wrong / accepted : 0.0);
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t seconds = argc > 1 ? atoi(argv[1]) : RUN_TIME;
+    uint32_t seed = argc > 2 ? atoi(argv[2]) : 1;
+    
+    printf("%u s per scenario, seed %u\n", seconds, seed);
+    printf("%-10s %8s %8s %19s %12s %16s %7s\n", 
+           "scenario", "packets", "diverge", "resync ms a/p95/max", "pkts avg/max", "wrong/accepted", "wrong");
+    
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        runScenario(scenarios[i], seconds, seed);
+    }
+    
+    return 0;
+}
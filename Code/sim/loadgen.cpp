@@ -0,0 +1,591 @@
+/*
+ * Load generator and stress test for the receive parser.
+ *
+ * First a set of virtual senders (the real send code) are run for one cycle of virtual
+ * time. Each one moves its sticks on and off, taps and holds random buttons, and has its
+ * own timing. Some also send IMU fields or repeat their button edges. The bytes each
+ * sender writes are saved as a stream, with the time each one was sent.
+ *
+ * There is no addressing in the protocol, so each stream goes to its own receiver (one
+ * radio per robot). The receivers are split across threads, and each thread has its own
+ * virtual clock.
+ *
+ * Throughput: all of the streams are put in the receive buffers at once, and the
+ * receivers parse them as fast as they can (wall clock). Run for 1, 2, 4, ... threads.
+ * Reported per thread count:
+ *   - pkt/s: packets parsed per second by all threads together (including reading the
+ *     stand-in serial)
+ *   - ns/pkt: parse time per packet, with the time to just read the bytes taken off
+ *   - scaling: pkt/s compared to one thread
+ *
+ * Breakdown: runs only in virtual time, so the results are the same on every run. The
+ * cost of a poll is modelled from the host: the time of a poll with nothing waiting,
+ * plus the throughput parse time per byte for each byte it reads. Each step makes those
+ * costs speedup times longer, which is the same as playing the streams speedup times
+ * faster to the host. Each thread is one loop that polls its receivers in turn (drain
+ * mode on), and a loop takes at least MIN_LOOP for the rest of the robot's work. A poll
+ * takes its modelled cost plus any virtual time it spent waiting on the port (empty
+ * checks cost only SPIN_COST here, since the modelled cost already covers them). Bytes
+ * go into the normal 64 byte receive buffers. Reported per step:
+ *   - speedup: how much faster than real time the streams are played
+ *   - offered pkt/s: packets per second the receivers have to keep up with
+ *   - loop ms: time between polls of a receiver (avg / max)
+ *   - delay: time bytes sat in the receive buffer before being read, in ms (avg / max)
+ *   - overflow: bytes lost to full receive buffers
+ * Times are in the streams' ms. Buffering breaks down at the first step that loses more
+ * than BREAK_OVERFLOW of the bytes, and delay breaks down at the first step with an
+ * average delay over DELAY_LIMIT. The max sustained rate is the last step before either
+ * one.
+ *
+ * These are host times (the breakdown scales them), and the baud rate of the radios isn't
+ * modelled, so the numbers only say how much headroom the parser itself has.
+ *
+ * Usage: loadgen [senders] [threads] [virtual seconds per step]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+
+#include "Controllers.h"
+
+#define NUM_SENDERS 256      //default number of virtual senders
+#define STEP_TIME 8          //default virtual seconds per breakdown step
+#define CYCLE_TIME 8192      //virtual ms of sender streams (a multiple of the 4096ms stamp period)
+#define TICK 1000            //time between sender updates (us)
+#define NUM_ROUNDS 3         //throughput rounds (the fastest is kept)
+#define POLL_ROUNDS 1000     //polls of each receiver to time an empty poll
+#define MIN_LOOP 1000        //shortest breakdown loop (us)
+#define SPIN_COST 1          //virtual time of an empty check of a receiver port (us)
+#define LOOKAHEAD 100000     //how far ahead of the clock bytes are delivered (us)
+#define DELAY_LIMIT 20       //average delay (ms) where delay has broken down
+#define BREAK_OVERFLOW 0.001 //fraction of bytes lost where buffering has broken down
+#define STOP_OVERFLOW 0.05   //stop the breakdown steps past this fraction of bytes lost
+#define MAX_SPEEDUP 1048576  //stop the breakdown steps here
+#define NUM_BUTTONS 12
+
+typedef std::chrono::steady_clock Clock;
+
+//bytes written by one sender
+struct SenderStream {
+    std::vector<uint32_t> times;   //time each byte was sent (us)
+    std::vector<uint8_t> bytes;
+    uint32_t packets = 0;
+};
+
+//a sender and how it is being driven
+struct VirtualSender {
+    HardwareSerial port;
+    tx::Controller controller;
+    uint32_t seed;
+    uint32_t offset;          //time of this sender's loop within each tick (us)
+    float freq[4];            //stick axis frequencies (Hz)
+    float phase[4];
+    float amp[4];
+    bool moving = false;      //sticks are moving
+    uint32_t nextMove = 0;    //time the sticks start or stop moving (ms)
+    int button = -1;          //button being held
+    uint32_t nextPress = 0;   //time of the next press or release (ms)
+    bool imu = false;         //sends the IMU fields
+
+    VirtualSender() : controller(port) {}
+};
+
+//a receiver and where it is in its stream
+struct VirtualReceiver {
+    HardwareSerial port;
+    rx::Controller controller;
+    const SenderStream *stream;
+    size_t next = 0;           //next byte of the stream to deliver
+    uint64_t cycleStart = 0;   //virtual time the current pass through the stream started (us)
+
+    VirtualReceiver() : controller(port) {}
+};
+
+/**
+ * Simple xorshift so the inputs are the same on every machine.
+ */
+float inputRandom(uint32_t &seed) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return (seed >> 8) / 16777216.0f;
+}
+
+/**
+ * Set one of the 12 buttons on the sender. 0-3 dpad, 4-7 buttons, then the joystick
+ * buttons and bumpers.
+ */
+void setButton(tx::Controller &sender, int button, bool pressed) {
+    if (button < 4) {
+        sender.setDpad((tx::Dir)button, pressed);
+    } else if (button < 8) {
+        sender.setButton((tx::Dir)(button - 4), pressed);
+    } else if (button < 10) {
+        sender.setJoyButton((tx::Dir)(button - 8), pressed);
+    } else {
+        sender.setBumper((tx::Dir)(button - 10), pressed);
+    }
+}
+
+/**
+ * Set up a sender with its own timing and inputs.
+ */
+void initSender(VirtualSender &sender, uint32_t index) {
+    sender.seed = 2463534242u + index * 7919;
+    sender.offset = inputRandom(sender.seed) * TICK;
+    for (int i = 0; i < 4; i++) {
+        sender.freq[i] = 0.1 + inputRandom(sender.seed) * 2;
+        sender.phase[i] = inputRandom(sender.seed) * 2 * M_PI;
+        sender.amp[i] = 0.2 + inputRandom(sender.seed) * 0.8;
+    }
+
+    simTime = sender.offset;
+    sender.controller.init();
+    sender.controller.setStamping(true);
+
+    //a mix of setups
+    sender.imu = index % 4 == 1;
+    if (index % 4 == 2) {
+        sender.controller.setRedundancy(1);
+    }
+}
+
+/**
+ * Set the inputs of a sender for the current time.
+ */
+void driveSender(VirtualSender &sender) {
+    tx::Controller &controller = sender.controller;
+    uint32_t now = millis();
+    float t = now / 1000.0;
+
+    //sticks move for a while, then rest
+    if (now >= sender.nextMove) {
+        sender.moving = !sender.moving;
+        sender.nextMove = now + 500 + inputRandom(sender.seed) * 3000;
+    }
+    for (int i = 0; i < 4; i++) {
+        float value = sender.moving ? sender.amp[i] * sin(2 * M_PI * sender.freq[i] * t + sender.phase[i]) : 0;
+        controller.setJoystick(i < 2 ? tx::LEFT : tx::RIGHT, i % 2 ? tx::Y : tx::X, value);
+    }
+    float trigger = sender.moving ? sin(2 * M_PI * sender.freq[0] * t) : 0;
+    controller.setTrigger(tx::LEFT, trigger > 0 ? trigger : 0);
+
+    //taps, with the odd long hold
+    if (now >= sender.nextPress) {
+        if (sender.button < 0) {
+            sender.button = inputRandom(sender.seed) * NUM_BUTTONS;
+            setButton(controller, sender.button, true);
+            bool hold = inputRandom(sender.seed) < 0.1;
+            sender.nextPress = now + (hold ? 300 + inputRandom(sender.seed) * 1200 : 40 + inputRandom(sender.seed) * 40);
+        } else {
+            setButton(controller, sender.button, false);
+            sender.button = -1;
+            sender.nextPress = now + 100 + inputRandom(sender.seed) * 700;
+        }
+    }
+
+    //noisy accelerometer sitting flat
+    if (sender.imu) {
+        controller.setField(tx::IMU_X, (inputRandom(sender.seed) - 0.5) * 0.04);
+        controller.setField(tx::IMU_Y, (inputRandom(sender.seed) - 0.5) * 0.04);
+        controller.setField(tx::IMU_Z, 1 + (inputRandom(sender.seed) - 0.5) * 0.04);
+    }
+}
+
+/**
+ * Run the virtual senders for one cycle and save what each one sends.
+ */
+void generateStreams(std::vector<SenderStream> &streams, uint32_t numSenders) {
+    std::vector<VirtualSender *> senders(numSenders);
+    for (uint32_t i = 0; i < numSenders; i++) {
+        senders[i] = new VirtualSender();
+        initSender(*senders[i], i);
+    }
+
+    streams.assign(numSenders, SenderStream());
+    for (uint64_t tick = 0; tick < (uint64_t)CYCLE_TIME * 1000; tick += TICK) {
+        for (uint32_t i = 0; i < numSenders; i++) {
+            VirtualSender &sender = *senders[i];
+            simTime = tick + sender.offset;
+            driveSender(sender);
+            sender.controller.update();
+
+            //each update sends at most one packet
+            if (!sender.port.sent.empty()) {
+                streams[i].packets++;
+                for (size_t j = 0; j < sender.port.sent.size(); j++) {
+                    streams[i].times.push_back(tick + sender.offset);
+                    streams[i].bytes.push_back(sender.port.sent[j]);
+                }
+                sender.port.sent.clear();
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < numSenders; i++) {
+        delete senders[i];
+    }
+}
+
+/**
+ * Make receivers for every numThreads-th stream, starting at first.
+ */
+void makeReceivers(std::vector<VirtualReceiver *> &receivers, const std::vector<SenderStream> &streams,
+                   size_t first, size_t numThreads, bool unlimited) {
+    for (size_t i = first; i < streams.size(); i += numThreads) {
+        VirtualReceiver *receiver = new VirtualReceiver();
+        if (unlimited) {
+            receiver->port.rxBufferSize = (size_t)-1;
+        }
+        receiver->stream = &streams[i];
+        receiver->controller.init();
+        receiver->controller.setDrain(true);
+        receiver->controller.setRefreshRequests(false);  //no link back to the senders
+        receiver->port.spinTime = SPIN_COST;
+        receivers.push_back(receiver);
+    }
+}
+
+void deleteReceivers(std::vector<VirtualReceiver *> &receivers) {
+    for (size_t i = 0; i < receivers.size(); i++) {
+        delete receivers[i];
+    }
+    receivers.clear();
+}
+
+/**
+ * Wait until every thread gets here. The count is left at a multiple of numThreads.
+ */
+void barrier(std::atomic<uint32_t> &count, uint32_t numThreads) {
+    uint32_t target = (count.fetch_add(1) / numThreads + 1) * numThreads;
+    while (count.load() < target) {
+        std::this_thread::yield();
+    }
+}
+
+//throughput results for one thread
+struct ParseResult {
+    double readTime;     //time to just read the bytes (ns)
+    double parseTime;    //time to parse the bytes (ns)
+    uint64_t packets;
+    Clock::time_point start;
+    Clock::time_point end;
+};
+
+/**
+ * Put a whole stream in the receiver's buffer.
+ */
+void fillReceiver(VirtualReceiver &receiver) {
+    const SenderStream &stream = *receiver.stream;
+    for (size_t i = 0; i < stream.bytes.size(); i++) {
+        receiver.port.deliver(stream.bytes[i], stream.times[i]);
+    }
+}
+
+/**
+ * Time one thread's share of the streams being parsed from full buffers.
+ */
+void parseShard(const std::vector<SenderStream> &streams, size_t first, size_t numThreads,
+                std::atomic<uint32_t> &ready, ParseResult &result) {
+    std::vector<VirtualReceiver *> receivers;
+    makeReceivers(receivers, streams, first, numThreads, true);
+    simTime = (uint64_t)CYCLE_TIME * 1000;
+
+    result.packets = 0;
+    for (size_t i = 0; i < receivers.size(); i++) {
+        result.packets += receivers[i]->stream->packets;
+    }
+
+    //time the serial stand-in alone
+    for (size_t i = 0; i < receivers.size(); i++) {
+        fillReceiver(*receivers[i]);
+    }
+    barrier(ready, numThreads);
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < receivers.size(); i++) {
+        HardwareSerial &port = receivers[i]->port;
+        while (port.available()) {
+            port.read();
+        }
+    }
+    result.readTime = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    //time the parser (the same bytes)
+    for (size_t i = 0; i < receivers.size(); i++) {
+        fillReceiver(*receivers[i]);
+    }
+    barrier(ready, numThreads);
+    result.start = Clock::now();
+    for (size_t i = 0; i < receivers.size(); i++) {
+        VirtualReceiver &receiver = *receivers[i];
+        while (receiver.port.available()) {
+            receiver.controller.receiveData();
+        }
+    }
+    result.end = Clock::now();
+    result.parseTime = std::chrono::duration<double, std::nano>(result.end - result.start).count();
+
+    deleteReceivers(receivers);
+}
+
+/**
+ * Time parsing all of the streams split across a number of threads. Returns the fastest
+ * round in packets per second, and the parse time per packet for that round.
+ */
+double runThroughput(const std::vector<SenderStream> &streams, uint32_t numThreads, uint32_t rounds, double &perPacket) {
+    double best = 0;
+
+    for (uint32_t round = 0; round < rounds; round++) {
+        std::vector<ParseResult> results(numThreads);
+        std::vector<std::thread> threads;
+        std::atomic<uint32_t> ready(0);
+        for (uint32_t i = 0; i < numThreads; i++) {
+            threads.push_back(std::thread(parseShard, std::cref(streams), i, numThreads,
+                                          std::ref(ready), std::ref(results[i])));
+        }
+        for (uint32_t i = 0; i < numThreads; i++) {
+            threads[i].join();
+        }
+
+        //all threads together, from the first start to the last finish
+        uint64_t packets = 0;
+        double parseOnly = 0;
+        Clock::time_point start = results[0].start, end = results[0].end;
+        for (uint32_t i = 0; i < numThreads; i++) {
+            packets += results[i].packets;
+            parseOnly += results[i].parseTime - results[i].readTime;
+            if (results[i].start < start) start = results[i].start;
+            if (results[i].end > end) end = results[i].end;
+        }
+        double rate = packets / std::chrono::duration<double>(end - start).count();
+
+        if (round == 0 || rate > best) {
+            best = rate;
+            perPacket = parseOnly / packets;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * Time a poll of a receiver with nothing waiting. Returns the fastest round in ns per poll.
+ */
+double measurePoll(const std::vector<SenderStream> &streams, uint32_t rounds) {
+    double best = 0;
+
+    for (uint32_t round = 0; round < rounds; round++) {
+        std::vector<VirtualReceiver *> receivers;
+        makeReceivers(receivers, streams, 0, 1, false);
+        simTime = 0;
+
+        Clock::time_point start = Clock::now();
+        for (uint32_t i = 0; i < POLL_ROUNDS; i++) {
+            for (size_t j = 0; j < receivers.size(); j++) {
+                receivers[j]->controller.receiveData();
+            }
+        }
+        double perPoll = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / POLL_ROUNDS / receivers.size();
+
+        if (round == 0 || perPoll < best) {
+            best = perPoll;
+        }
+        deleteReceivers(receivers);
+    }
+
+    return best;
+}
+
+//breakdown results for one thread
+struct StepResult {
+    double loopTotal;      //sum of the loop times (us)
+    double loopMax;        //longest loop time (us)
+    uint64_t loops;
+    uint64_t bytes;        //bytes delivered
+    uint64_t overflows;    //bytes lost to full buffers
+    uint64_t bytesRead;    //bytes read by the receivers
+    uint64_t waitTotal;    //total time the bytes read sat in the buffers (us)
+    uint64_t waitMax;      //longest time a byte sat in a buffer (us)
+};
+
+/**
+ * Deliver the bytes of a receiver's stream up to a virtual time, starting the stream
+ * over at the end of each cycle.
+ *
+ * @return number of bytes delivered.
+ */
+uint32_t deliverUntil(VirtualReceiver &receiver, uint64_t until) {
+    const SenderStream &stream = *receiver.stream;
+    uint32_t delivered = 0;
+    while (true) {
+        if (receiver.next >= stream.bytes.size()) {
+            receiver.next = 0;
+            receiver.cycleStart += (uint64_t)CYCLE_TIME * 1000;
+        }
+        uint64_t arrival = receiver.cycleStart + stream.times[receiver.next];
+        if (arrival > until) {
+            break;
+        }
+        receiver.port.deliver(stream.bytes[receiver.next], arrival);
+        receiver.next++;
+        delivered++;
+    }
+    return delivered;
+}
+
+/**
+ * Play back one thread's share of the streams in virtual time, with the poll costs made 
+ * speedup times longer.
+ *
+ * @param pollCost - modelled time of a poll with nothing waiting (ns).
+ * @param byteCost - modelled time to parse a byte (ns).
+ */
+void replayShard(const std::vector<SenderStream> &streams, size_t first, size_t numThreads,
+                 uint32_t speedup, double seconds, double pollCost, double byteCost, StepResult &result) {
+    std::vector<VirtualReceiver *> receivers;
+    makeReceivers(receivers, streams, first, numThreads, false);
+
+    result = StepResult();
+    simTime = 0;
+
+    while (simTime < (uint64_t)(seconds * 1000000)) {
+        uint64_t loopStart = simTime;
+
+        //poll every receiver in turn. Bytes are delivered ahead of time, they only reach
+        //the buffer once they arrive.
+        for (size_t i = 0; i < receivers.size(); i++) {
+            VirtualReceiver &receiver = *receivers[i];
+            result.bytes += deliverUntil(receiver, simTime + LOOKAHEAD);
+
+            uint64_t bytesBefore = receiver.port.bytesRead;
+            receiver.controller.receiveData();
+            simTime += (pollCost + (receiver.port.bytesRead - bytesBefore) * byteCost) * speedup / 1000;
+        }
+
+        //the rest of the robot's loop
+        if (simTime < loopStart + MIN_LOOP) {
+            simTime = loopStart + MIN_LOOP;
+        }
+
+        double loop = simTime - loopStart;
+        result.loopTotal += loop;
+        if (loop > result.loopMax) {
+            result.loopMax = loop;
+        }
+        result.loops++;
+    }
+
+    for (size_t i = 0; i < receivers.size(); i++) {
+        HardwareSerial &port = receivers[i]->port;
+        result.overflows += port.overflows;
+        result.bytesRead += port.bytesRead;
+        result.waitTotal += port.waitTotal;
+        if (port.waitMax > result.waitMax) {
+            result.waitMax = port.waitMax;
+        }
+    }
+
+    deleteReceivers(receivers);
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t numSenders = argc > 1 ? atoi(argv[1]) : NUM_SENDERS;
+    uint32_t maxThreads = argc > 2 ? atoi(argv[2]) : std::thread::hardware_concurrency();
+    double seconds = argc > 3 ? atof(argv[3]) : STEP_TIME;
+    if (maxThreads < 1) {
+        maxThreads = 1;
+    }
+    if (maxThreads > numSenders) {
+        maxThreads = numSenders;
+    }
+
+    //generate
+    std::vector<SenderStream> streams;
+    generateStreams(streams, numSenders);
+    uint64_t packets = 0, bytes = 0;
+    for (size_t i = 0; i < streams.size(); i++) {
+        packets += streams[i].packets;
+        bytes += streams[i].bytes.size();
+    }
+    double packetRate = packets * 1000.0 / CYCLE_TIME;
+    printf("%u senders, %.0f pkt/s and %.0f bytes/s at real time (%.1f bytes/pkt)\n",
+           numSenders, packetRate, bytes * 1000.0 / CYCLE_TIME, (double)bytes / packets);
+
+    //throughput
+    printf("\nthroughput, best of %u\n", NUM_ROUNDS);
+    printf("%7s %10s %8s %8s\n", "threads", "pkt/s", "ns/pkt", "scaling");
+    double base = 0, byteCost = 0;
+    for (uint32_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+        double perPacket = 0;
+        double rate = runThroughput(streams, numThreads, NUM_ROUNDS, perPacket);
+        if (numThreads == 1) {
+            base = rate;
+            byteCost = perPacket * packets / bytes;
+        }
+        printf("%7u %10.0f %8.1f %7.2fx\n", numThreads, rate, perPacket, rate / base);
+    }
+
+    //breakdown
+    double pollCost = measurePoll(streams, NUM_ROUNDS);
+    printf("\nbreakdown, %u threads, %.1f virtual s per step\n", maxThreads, seconds);
+    printf("poll cost: %.1f ns per poll + %.1f ns per byte (host)\n", pollCost, byteCost);
+    printf("%7s %12s %17s %15s %9s\n", "speedup", "offered pkt/s", "loop ms avg/max", "delay avg/max", "overflow");
+    uint32_t sustained = 0, bufferBreak = 0, delayBreak = 0;
+    for (uint32_t speedup = 1; speedup <= MAX_SPEEDUP; speedup *= 2) {
+        std::vector<StepResult> results(maxThreads);
+        std::vector<std::thread> threads;
+        for (uint32_t i = 0; i < maxThreads; i++) {
+            threads.push_back(std::thread(replayShard, std::cref(streams), i, maxThreads, speedup, seconds,
+                                          pollCost, byteCost, std::ref(results[i])));
+        }
+        for (uint32_t i = 0; i < maxThreads; i++) {
+            threads[i].join();
+        }
+
+        StepResult total = StepResult();
+        for (uint32_t i = 0; i < maxThreads; i++) {
+            total.loopTotal += results[i].loopTotal;
+            total.loops += results[i].loops;
+            if (results[i].loopMax > total.loopMax) total.loopMax = results[i].loopMax;
+            total.bytes += results[i].bytes;
+            total.overflows += results[i].overflows;
+            total.bytesRead += results[i].bytesRead;
+            total.waitTotal += results[i].waitTotal;
+            if (results[i].waitMax > total.waitMax) total.waitMax = results[i].waitMax;
+        }
+        double loopAvg = total.loops ? total.loopTotal / total.loops / 1000 : 0;
+        double delayAvg = total.bytesRead ? (double)total.waitTotal / total.bytesRead / 1000 : 0;
+        double overflow = total.bytes ? (double)total.overflows / total.bytes : 0;
+
+        printf("%7u %12.0f %8.2f/%-8.2f %7.2f/%-7.2f %8.3f%%\n", speedup, packetRate * speedup,
+               loopAvg, total.loopMax / 1000, delayAvg, total.waitMax / 1000.0, 100 * overflow);
+
+        if (overflow > BREAK_OVERFLOW && !bufferBreak) {
+            bufferBreak = speedup;
+        }
+        if (delayAvg > DELAY_LIMIT && !delayBreak) {
+            delayBreak = speedup;
+        }
+        if (!bufferBreak && !delayBreak) {
+            sustained = speedup;
+        }
+        if (overflow > STOP_OVERFLOW) {
+            break;
+        }
+    }
+
+    printf("\nmax sustained: %.0f pkt/s (%ux)\n", packetRate * sustained, sustained);
+    if (bufferBreak) {
+        printf("buffering breaks down: %.0f pkt/s (%ux)\n", packetRate * bufferBreak, bufferBreak);
+    }
+    if (delayBreak) {
+        printf("delay breaks down: %.0f pkt/s (%ux)\n", packetRate * delayBreak, delayBreak);
+    }
+
+    return 0;
+}
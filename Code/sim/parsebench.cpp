@@ -0,0 +1,199 @@
+/*
+ * Benchmark for how fast the receiver parses packets, with and without extension fields.
+ *
+ * Each scenario fills the receive buffer with packets of one shape, then times (wall
+ * clock) receiveData() until the buffer is empty. The same bytes are also read straight
+ * out of the port to time the stand-in serial code, and that is taken off the result.
+ * Reported per scenario:
+ *   - bytes: bytes per packet
+ *   - ns/pkt: parse time per packet
+ *   - ns/byte: parse time per byte
+ *   - vs base: parse time compared to the first scenario
+ *
+ * These are host times, so only the ratios between scenarios mean much for a board.
+ *
+ * Usage: parsebench [packets per scenario] [rounds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <chrono>
+
+#include "Controllers.h"
+
+#define NUM_PACKETS 100000  //default packets per scenario
+#define NUM_ROUNDS 5        //default rounds (the fastest is kept)
+
+//header bits (see the send code)
+#define JOY_L     0b00000001
+#define JOY_R     0b00000010
+#define TRIG_L    0b00000100
+#define TRIG_R    0b00001000
+#define BUT_L     0b00010000
+#define BUT_R     0b00100000
+#define STAMP     0b01000000
+#define EXTENDED  0b10000000
+
+struct Scenario {
+    const char *name;
+    uint8_t header;
+    uint8_t bitmap;   //extension fields (if EXTENDED)
+};
+
+const Scenario scenarios[] = {
+    { "joy L",        JOY_L,                           0 },
+    { "left half",    JOY_L | TRIG_L | BUT_L,          0 },
+    { "stamped",      STAMP | JOY_L | TRIG_L | BUT_L,  0 },
+    { "ext buttons",  EXTENDED | JOY_L,                1 << rx::EXTRA_BUTTONS },
+    { "ext imu",      EXTENDED | JOY_L,                (1 << rx::IMU_X) | (1 << rx::IMU_Y) | (1 << rx::IMU_Z) },
+    { "ext all",      EXTENDED | JOY_L | TRIG_L | BUT_L, (1 << rx::NUM_EXT_FIELDS) - 1 },
+};
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * Get the next button edge counts for one side: one random button gets another edge, 
+ * so the receiver has one edge to replay per packet. The check is added like the 
+ * controller does.
+ */
+uint16_t edgeCounts[2];
+uint16_t nextEdges(int side) {
+    int button = rand() % 6;
+    uint16_t count = ((edgeCounts[side] >> (button * 2)) + 1) & 0b11;
+    edgeCounts[side] = (edgeCounts[side] & ~(0b11 << (button * 2))) | (count << (button * 2));
+
+    uint16_t counts = edgeCounts[side];
+    uint8_t check = (counts ^ (counts >> 4) ^ (counts >> 8) ^ EDGE_CHECK) & 0x0F;
+    return counts | (check << 12);
+}
+
+/**
+ * Build a packet with random data for the given header and bitmap (the edge counts and 
+ * CRC are real so the receiver doesn't throw them out).
+ */
+void buildPacket(std::vector<uint8_t> &packet, uint8_t header, uint8_t bitmap) {
+    packet.clear();
+    packet.push_back(header);
+    if (header & EXTENDED) {
+        packet.push_back(bitmap);
+    }
+
+    int dataBytes = 0;
+    if (header & STAMP) dataBytes += 2;
+    if (header & JOY_L) dataBytes += 2;
+    if (header & JOY_R) dataBytes += 2;
+    if (header & TRIG_L) dataBytes++;
+    if (header & TRIG_R) dataBytes++;
+    if (header & BUT_L) dataBytes++;
+    if (header & BUT_R) dataBytes++;
+
+    for (int i = 0; i < dataBytes; i++) {
+        packet.push_back(rand() & 0xFF);
+    }
+
+    for (int i = 0; i < rx::NUM_EXT_FIELDS; i++) {
+        if (bitmap & (1 << i)) {
+            if (i == rx::BUTTON_EDGES_L || i == rx::BUTTON_EDGES_R) {
+                uint16_t counts = nextEdges(i - rx::BUTTON_EDGES_L);
+                packet.push_back(counts >> 8);
+                packet.push_back(counts & 0xFF);
+            } else {
+                for (int j = 0; j < rx::extFields[i].width; j++) {
+                    packet.push_back(rand() & 0xFF);
+                }
+            }
+        }
+    }
+
+    //extended packets end with a CRC of the rest
+    if (header & EXTENDED) {
+        uint8_t crc = 0;
+        for (size_t i = 0; i < packet.size(); i++) {
+            crc = rx::crc8(crc, packet[i]);
+        }
+        packet.push_back(crc);
+    }
+}
+
+/**
+ * Fill the port with packets of one shape.
+ *
+ * @return number of bytes delivered.
+ */
+size_t fillPort(HardwareSerial &port, const Scenario &scenario, uint32_t numPackets) {
+    std::vector<uint8_t> packet;
+    size_t bytes = 0;
+    for (uint32_t i = 0; i < numPackets; i++) {
+        buildPacket(packet, scenario.header, scenario.bitmap);
+        for (size_t j = 0; j < packet.size(); j++) {
+            port.deliver(packet[j], simTime);
+        }
+        bytes += packet.size();
+    }
+    return bytes;
+}
+
+/**
+ * Time parsing one scenario. Returns the fastest round in ns per packet (with the time to
+ * just read the bytes taken off) and the bytes per packet.
+ */
+double runScenario(const Scenario &scenario, uint32_t numPackets, uint32_t rounds, double &bytesPerPacket) {
+    double best = 0;
+
+    for (uint32_t round = 0; round < rounds; round++) {
+        HardwareSerial port;
+        port.rxBufferSize = (size_t)-1;
+        rx::Controller receiver(port);
+        receiver.init();
+
+        //time the serial stand-in alone
+        srand(round + 1);
+        edgeCounts[0] = edgeCounts[1] = 0;
+        size_t bytes = fillPort(port, scenario, numPackets);
+        Clock::time_point start = Clock::now();
+        while (port.available()) {
+            port.read();
+        }
+        double readTime = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+        //time the parser (the same bytes)
+        srand(round + 1);
+        edgeCounts[0] = edgeCounts[1] = 0;
+        fillPort(port, scenario, numPackets);
+        start = Clock::now();
+        while (port.available()) {
+            receiver.receiveData();
+        }
+        double parseTime = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+        double perPacket = (parseTime - readTime) / numPackets;
+        if (round == 0 || perPacket < best) {
+            best = perPacket;
+        }
+        bytesPerPacket = (double)bytes / numPackets;
+    }
+
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t numPackets = argc > 1 ? atoi(argv[1]) : NUM_PACKETS;
+    uint32_t rounds = argc > 2 ? atoi(argv[2]) : NUM_ROUNDS;
+
+    printf("%u packets per scenario, best of %u\n", numPackets, rounds);
+    printf("%-12s %6s %8s %8s %8s\n", "scenario", "bytes", "ns/pkt", "ns/byte", "vs base");
+
+    double base = 0;
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        double bytes = 0;
+        double perPacket = runScenario(scenarios[i], numPackets, rounds, bytes);
+        if (i == 0) {
+            base = perPacket;
+        }
+        printf("%-12s %6.1f %8.1f %8.2f %7.2fx\n",
+               scenarios[i].name, bytes, perPacket, perPacket / bytes, perPacket / base);
+    }
+
+    return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * Benchmark for how many short button taps get lost on a lossy link, for each setting
+ * of the sender's button edge redundancy.
+ *
+ * Each run taps a random button every few hundred ms (held for 40 to 80ms) while the
+ * sticks move, and sends it through a faulty link to a receiver. Refresh requests go back
+ * to the sender on a clean link. The receiver's clicks are read every poll. Reported per
+ * scenario and number of repeats:
+ *   - taps: taps made on the sender
+ *   - lost: taps the receiver never clicked
+ *   - extra: clicks the receiver saw with no tap of that button waiting for one (from 
+ *     bad bytes)
+ *   - bytes/s: bytes sent by the sender
+ *
+ * Usage: tapbench [seconds per run] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Controllers.h"
+#include "LinkModel.h"
+
+#define RUN_TIME 60          //default seconds per run
+#define TICK 1000            //time between sender updates and receiver polls (us)
+#define MAX_REPEATS 3        //highest redundancy setting to try
+#define NUM_BUTTONS 12
+
+struct Scenario {
+    const char *name;
+    LinkFaults faults;
+};
+
+//faults: drop, flip, burst, burst length, dup, stall, stall time (us)
+const Scenario scenarios[] = {
+    { "clean",     { 0,     0,     0,     0,  0,     0,     0     } },
+    { "drop 1%",   { 0.01,  0,     0,     0,  0,     0,     0     } },
+    { "drop 5%",   { 0.05,  0,     0,     0,  0,     0,     0     } },
+    { "burst 20",  { 0,     0,     0.002, 20, 0,     0,     0     } },
+    { "mixed",     { 0.005, 0.005, 0.001, 10, 0.005, 0.005, 8000  } },
+};
+
+/**
+ * Simple xorshift so the inputs are the same on every machine.
+ */
+uint32_t inputSeed;
+float inputRandom() {
+    inputSeed ^= inputSeed << 13;
+    inputSeed ^= inputSeed >> 17;
+    inputSeed ^= inputSeed << 5;
+    return (inputSeed >> 8) / 16777216.0f;
+}
+
+/**
+ * Set one of the 12 buttons on the sender. 0-3 dpad, 4-7 buttons, then the joystick
+ * buttons and bumpers.
+ */
+void setButton(tx::Controller &sender, int button, bool pressed) {
+    if (button < 4) {
+        sender.setDpad((tx::Dir)button, pressed);
+    } else if (button < 8) {
+        sender.setButton((tx::Dir)(button - 4), pressed);
+    } else if (button < 10) {
+        sender.setJoyButton((tx::Dir)(button - 8), pressed);
+    } else {
+        sender.setBumper((tx::Dir)(button - 10), pressed);
+    }
+}
+
+/**
+ * Read (and clear) the click for one of the 12 buttons on the receiver.
+ */
+bool readClick(rx::Controller &receiver, int button) {
+    if (button < 4) {
+        return receiver.dpadClick((rx::Dir)button);
+    } else if (button < 8) {
+        return receiver.buttonClick((rx::Dir)(button - 4));
+    } else if (button < 10) {
+        return receiver.joyButtonClick((rx::Dir)(button - 8));
+    } else {
+        return receiver.bumperClick((rx::Dir)(button - 10));
+    }
+}
+
+/**
+ * Run one scenario with the given number of repeats and print a line of results.
+ */
+void runScenario(const Scenario &scenario, uint8_t repeats, uint32_t seconds, uint32_t seed) {
+    HardwareSerial senderPort, receiverPort;
+    tx::Controller sender(senderPort);
+    rx::Controller receiver(receiverPort);
+
+    LinkModel link(senderPort, receiverPort, seed);
+    link.setFaults(scenario.faults);
+    LinkModel backLink(receiverPort, senderPort, seed);
+
+    simTime = 0;
+    inputSeed = seed;
+    sender.init();
+    sender.setRedundancy(repeats);
+    receiver.init();
+    receiver.setRefreshRequests(true);
+
+    int32_t waiting[NUM_BUTTONS] = { 0 };  //taps not clicked yet
+    int32_t taps = 0, lost = 0, extra = 0;
+    int tapButton = -1;         //button being held
+    uint32_t nextEvent = 500;   //time of the next press or release (ms)
+
+    uint64_t nextTick = 0;
+    while (simTime < (uint64_t)seconds * 1000000) {
+        //the receiver may have used up time waiting on a packet
+        if (simTime < nextTick) {
+            simTime = nextTick;
+        }
+        nextTick = simTime + TICK;
+
+        //sender. Sticks keep moving so there is other traffic.
+        float t = millis() / 1000.0;
+        sender.setJoystick(tx::LEFT, tx::X, sin(t * 1.3));
+        sender.setJoystick(tx::LEFT, tx::Y, cos(t * 0.7));
+
+        if (millis() >= nextEvent) {
+            if (tapButton < 0) {
+                tapButton = inputRandom() * NUM_BUTTONS;
+                setButton(sender, tapButton, true);
+                taps++;
+                
+                //a tap of this button that still hasn't clicked is lost
+                if (waiting[tapButton] > 0) {
+                    lost += waiting[tapButton];
+                    waiting[tapButton] = 0;
+                }
+                waiting[tapButton]++;
+                nextEvent = millis() + 40 + inputRandom() * 40;
+            } else {
+                setButton(sender, tapButton, false);
+                tapButton = -1;
+                nextEvent = millis() + 100 + inputRandom() * 300;
+            }
+        }
+
+        sender.update();
+        link.transfer();
+        backLink.transfer();
+
+        //receiver
+        receiver.receiveData();
+        for (int i = 0; i < NUM_BUTTONS; i++) {
+            if (readClick(receiver, i)) {
+                if (waiting[i] > 0) {
+                    waiting[i]--;
+                } else {
+                    extra++;
+                }
+            }
+        }
+    }
+
+    //summarize
+    for (int i = 0; i < NUM_BUTTONS; i++) {
+        lost += waiting[i];
+    }
+
+    printf("%-10s %7u %6d %6d %7.3f%% %6d %8.0f\n",
+           scenario.name, repeats, taps, lost, taps ? 100.0 * lost / taps : 0.0, extra,
+           (double)link.stats().bytes / seconds);
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t seconds = argc > 1 ? atoi(argv[1]) : RUN_TIME;
+    uint32_t seed = argc > 2 ? atoi(argv[2]) : 1;
+
+    printf("%u s per run, seed %u\n", seconds, seed);
+    printf("%-10s %7s %6s %6s %8s %6s %8s\n",
+           "scenario", "repeats", "taps", "lost", "lost", "extra", "bytes/s");
+
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        for (uint8_t repeats = 0; repeats <= MAX_REPEATS; repeats++) {
+            runScenario(scenarios[i], repeats, seconds, seed);
+        }
+    }
+
+    return 0;
+}